@@ -0,0 +1,122 @@
+#include "batch_renderer.h"
+#include "resource_manager.h"
+
+#include <gdiplus.h>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cwchar>
+#include <algorithm>
+
+namespace
+{
+
+bool GetEncoderClsid(const wchar_t* mime_type, CLSID& clsid)
+{
+   UINT count = 0;
+   UINT size = 0;
+   if (Gdiplus::Ok != Gdiplus::GetImageEncodersSize(&count, &size) || 0 == size)
+   {
+      return false;
+   }
+
+   std::unique_ptr<char[]> buffer(new char[size]);
+   auto codecs = reinterpret_cast<Gdiplus::ImageCodecInfo*>(buffer.get());
+   if (Gdiplus::Ok != Gdiplus::GetImageEncoders(count, size, codecs))
+   {
+      return false;
+   }
+
+   for (UINT index = 0; index < count; ++index)
+   {
+      if (0 == std::wcscmp(codecs[index].MimeType, mime_type))
+      {
+         clsid = codecs[index].Clsid;
+         return true;
+      }
+   }
+   return false;
+}
+
+}
+
+/////////////// class StickerBatchRenderer /////////////////
+
+StickerBatchRenderer::StickerBatchRenderer(unsigned long thread_count) :
+   m_thread_count(thread_count), m_jobs()
+{
+   if (0 == m_thread_count)
+   {
+      m_thread_count = (std::max)(1U, std::thread::hardware_concurrency());
+   }
+}
+
+StickerBatchRenderer::~StickerBatchRenderer()
+{
+   // no code
+}
+
+void StickerBatchRenderer::AddJob(const std::wstring& file_name, long width, long height, bool is_collapsed, TFiller filler)
+{
+   m_jobs.push_back(Job{ file_name, width, height, is_collapsed, std::move(filler) });
+}
+
+unsigned long StickerBatchRenderer::GetJobCount() const
+{
+   return static_cast<unsigned long>(m_jobs.size());
+}
+
+unsigned long StickerBatchRenderer::Run()
+{
+   std::vector<Job> jobs;
+   jobs.swap(m_jobs);
+
+   CLSID encoder;
+   if (jobs.empty() || !GetEncoderClsid(L"image/png", encoder))
+   {
+      return 0;
+   }
+
+   // Workers take jobs one by one, so long jobs don't stall a whole thread's share.
+   std::atomic<size_t> next_job(0);
+   std::atomic<unsigned long> saved_count(0);
+   auto worker = [this, &jobs, &encoder, &next_job, &saved_count]()
+   {
+      for (auto index = next_job++; index < jobs.size(); index = next_job++)
+      {
+         if (RenderJob(jobs[index], encoder))
+         {
+            ++saved_count;
+         }
+      }
+      BGO::ResourceManager::GetInstance().ReleaseThreadResources();
+   };
+
+   const auto thread_count = (std::min)(static_cast<size_t>(m_thread_count), jobs.size());
+   std::vector<std::thread> threads;
+   threads.reserve(thread_count - 1);
+   for (size_t index = 1; index < thread_count; ++index)
+   {
+      threads.emplace_back(worker);
+   }
+   worker();
+   for (auto& thread : threads)
+   {
+      thread.join();
+   }
+
+   return saved_count;
+}
+
+bool StickerBatchRenderer::RenderJob(const Job& job, const CLSID& encoder) const
+{
+   HeadlessSticker sticker(job.m_width, job.m_height);
+   if (job.m_filler)
+   {
+      job.m_filler(sticker);
+   }
+   sticker.SetCollapsed(job.m_is_collapsed);
+
+   auto image = sticker.Render();
+   return (nullptr != image) && (Gdiplus::Ok == image->Save(job.m_file_name.c_str(), &encoder, nullptr));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "sticker.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// Renders many stickers offscreen into image files. Stickers are rendered
+// by a pool of worker threads, each with its own GDI+ resources.
+class StickerBatchRenderer
+{
+public:
+   // Fills content of a sticker before rendering.
+   using TFiller = std::function<void(StickerModel& sticker)>;
+
+   // Zero thread count means one thread per hardware thread.
+   explicit StickerBatchRenderer(unsigned long thread_count = 0);
+   ~StickerBatchRenderer();
+
+   // Adds a sticker to render into a PNG file. Width and height define
+   // the size of the collapsed sticker.
+   void AddJob(const std::wstring& file_name, long width, long height, bool is_collapsed, TFiller filler);
+   unsigned long GetJobCount() const;
+
+   // Renders all added jobs and forgets them. Returns amount of saved images.
+   unsigned long Run();
+
+private:
+   struct Job
+   {
+      std::wstring m_file_name;
+      long m_width;
+      long m_height;
+      bool m_is_collapsed;
+      TFiller m_filler;
+   };
+
+   bool RenderJob(const Job& job, const CLSID& encoder) const;
+
+private:
+   unsigned long m_thread_count;
+   std::vector<Job> m_jobs;
+};
@@ -0,0 +1,102 @@
+#include "callback_dispatcher.h"
+
+#include <cassert>
+#include <algorithm>
+
+/////////////// class CallbackDispatcher /////////////////
+
+CallbackDispatcher::CallbackDispatcher(std::unique_ptr<IStickerCallback>&& callback, unsigned long thread_count) :
+   m_callback(std::move(callback)), m_executor(), m_mutex(), m_condition(), m_tasks(),
+   m_is_stopping(false), m_workers()
+{
+   assert(m_callback);
+
+   const auto worker_count = (std::max)(1UL, thread_count);
+   m_workers.reserve(worker_count);
+   for (auto index = 0UL; index < worker_count; ++index)
+   {
+      m_workers.emplace_back(&CallbackDispatcher::RunWorker, this);
+   }
+}
+
+CallbackDispatcher::CallbackDispatcher(std::unique_ptr<IStickerCallback>&& callback, TExecutor executor) :
+   m_callback(std::move(callback)), m_executor(std::move(executor)), m_mutex(), m_condition(), m_tasks(),
+   m_is_stopping(false), m_workers()
+{
+   assert(m_callback && m_executor);
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.clear();
+      m_is_stopping = true;
+   }
+   m_condition.notify_all();
+
+   for (auto& worker : m_workers)
+   {
+      worker.join();
+   }
+}
+
+void CallbackDispatcher::DropPendingEvents()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_tasks.clear();
+}
+
+void CallbackDispatcher::OnHeaderClick(unsigned long section_index)
+{
+   Dispatch([section_index](IStickerCallback& callback) { callback.OnHeaderClick(section_index); });
+}
+
+void CallbackDispatcher::OnItemClick(unsigned long section_index, unsigned long item_index)
+{
+   Dispatch([section_index, item_index](IStickerCallback& callback) { callback.OnItemClick(section_index, item_index); });
+}
+
+void CallbackDispatcher::OnFooterClick(unsigned long section_index)
+{
+   Dispatch([section_index](IStickerCallback& callback) { callback.OnFooterClick(section_index); });
+}
+
+void CallbackDispatcher::Dispatch(std::function<void(IStickerCallback& callback)> event)
+{
+   // Task of the executor may outlive the dispatcher, so it shares the callback.
+   auto callback = m_callback;
+   auto task = [callback, event]() { event(*callback); };
+
+   if (m_executor)
+   {
+      m_executor(std::move(task));
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(std::move(task));
+   }
+   m_condition.notify_one();
+}
+
+void CallbackDispatcher::RunWorker()
+{
+   for (;;)
+   {
+      std::function<void()> task;
+      {
+         std::unique_lock<std::mutex> lock(m_mutex);
+         m_condition.wait(lock, [this]() { return m_is_stopping || !m_tasks.empty(); });
+
+         if (m_tasks.empty())
+         {
+            return;
+         }
+         task = std::move(m_tasks.front());
+         m_tasks.pop_front();
+      }
+      task();
+   }
+}
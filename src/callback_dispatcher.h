@@ -0,0 +1,53 @@
+#pragma once
+
+#include "sticker.h"
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Callback, which queues click events instead of handling them in the click, so slow
+// handlers (I/O, modal dialogs) don't stall painting and hover feedback. Events are
+// passed to the wrapped callback by the executor of the host or by own worker threads.
+// The wrapped callback is called off the UI thread and must not touch the sticker.
+class CallbackDispatcher : public IStickerCallback
+{
+public:
+   // Runs the task on some thread of the host, e.g. posts it to its thread pool.
+   using TExecutor = std::function<void(std::function<void()> task)>;
+
+   // Events are handled by own worker threads. Single thread keeps the click order,
+   // more threads handle events concurrently.
+   explicit CallbackDispatcher(std::unique_ptr<IStickerCallback>&& callback, unsigned long thread_count = 1);
+   // Events are handled by the executor, the wrapped callback lives till its last task.
+   CallbackDispatcher(std::unique_ptr<IStickerCallback>&& callback, TExecutor executor);
+   // Drops the queued events and waits for the ones being handled by own workers.
+   ~CallbackDispatcher();
+
+   // Drops the events queued for own workers, e.g. on shutdown. Tasks already passed
+   // to the executor are up to the host.
+   void DropPendingEvents();
+
+   // IStickerCallback overrides
+   virtual void OnHeaderClick(unsigned long section_index) override;
+   virtual void OnItemClick(unsigned long section_index, unsigned long item_index) override;
+   virtual void OnFooterClick(unsigned long section_index) override;
+
+private:
+   void Dispatch(std::function<void(IStickerCallback& callback)> event);
+   void RunWorker();
+
+private:
+   std::shared_ptr<IStickerCallback> m_callback;
+   TExecutor m_executor;
+
+   std::mutex m_mutex;
+   std::condition_variable m_condition;
+   std::deque<std::function<void()>> m_tasks;
+   bool m_is_stopping;
+   std::vector<std::thread> m_workers;
+};
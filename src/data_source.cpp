@@ -0,0 +1,119 @@
+#include "data_source.h"
+
+#include <cassert>
+
+namespace
+{
+
+//////////// Constants /////////////
+
+const auto g_default_prefetch_count = 2UL;
+const auto g_default_cache_size = 16UL;
+const auto g_default_item_page_size = 200UL;
+
+} // namespace
+
+IStickerDataSource::~IStickerDataSource()
+{
+   // no code
+}
+
+/////////////// struct DataSourceOptions /////////////////
+
+DataSourceOptions::DataSourceOptions() :
+   m_prefetch_count(g_default_prefetch_count),
+   m_cache_size(g_default_cache_size),
+   m_item_page_size(g_default_item_page_size)
+{
+   // no code
+}
+
+/////////////// class DataSourceCache /////////////////
+
+DataSourceCache::DataSourceCache(std::unique_ptr<IStickerDataSource>&& source, const DataSourceOptions& options) :
+   m_source(std::move(source)), m_options(options), m_pulled_titles(), m_content_sections(), m_contents()
+{
+   assert(m_source && m_options.m_item_page_size > 0);
+}
+
+IStickerDataSource& DataSourceCache::GetSource() const
+{
+   return *m_source;
+}
+
+const DataSourceOptions& DataSourceCache::GetOptions() const
+{
+   return m_options;
+}
+
+void DataSourceCache::Reset(unsigned long section_count)
+{
+   m_pulled_titles.assign(section_count, false);
+   m_content_sections.clear();
+   m_contents.clear();
+}
+
+bool DataSourceCache::IsTitlePulled(unsigned long index) const
+{
+   return index < m_pulled_titles.size() && m_pulled_titles[index];
+}
+
+void DataSourceCache::SetTitlePulled(unsigned long index)
+{
+   if (index >= m_pulled_titles.size())
+   {
+      m_pulled_titles.resize(index + 1, false);
+   }
+   m_pulled_titles[index] = true;
+}
+
+bool DataSourceCache::IsContentPulled(unsigned long index) const
+{
+   return m_contents.count(index) > 0;
+}
+
+void DataSourceCache::TouchContent(unsigned long index)
+{
+   const auto content = m_contents.find(index);
+   if (content != m_contents.end())
+   {
+      m_content_sections.splice(m_content_sections.begin(), m_content_sections, content->second.m_position);
+      return;
+   }
+   m_content_sections.push_front(index);
+   m_contents[index] = Content{ m_content_sections.begin(), 0 };
+}
+
+void DataSourceCache::ReleaseContent(unsigned long index)
+{
+   const auto content = m_contents.find(index);
+   if (content != m_contents.end())
+   {
+      m_content_sections.erase(content->second.m_position);
+      m_contents.erase(content);
+   }
+}
+
+unsigned long DataSourceCache::GetPulledItemCount(unsigned long index) const
+{
+   const auto content = m_contents.find(index);
+   return (content != m_contents.end()) ? content->second.m_item_count : 0;
+}
+
+void DataSourceCache::SetPulledItemCount(unsigned long index, unsigned long count)
+{
+   const auto content = m_contents.find(index);
+   assert(content != m_contents.end());
+   if (content != m_contents.end())
+   {
+      content->second.m_item_count = count;
+   }
+}
+
+size_t DataSourceCache::GetMemorySize() const
+{
+   // List and hash nodes are estimated by their payload and two pointers.
+   return m_pulled_titles.capacity() / 8 +
+          m_content_sections.size() * (sizeof(unsigned long) + 2 * sizeof(void*)) +
+          m_contents.size() * (sizeof(unsigned long) + sizeof(Content) + 2 * sizeof(void*));
+}
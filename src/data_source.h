@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+class ISection;
+
+// Content of a sticker, which the sticker pulls on demand instead of having it all pushed
+// in advance: titles of the shown sections and content of the expanded ones. The source
+// fills the given section through ISection, the same way a host pushes it.
+class IStickerDataSource
+{
+public:
+   virtual ~IStickerDataSource();
+
+   virtual unsigned long GetSectionCount() = 0;
+   virtual void FillTitle(unsigned long section_index, ISection& section) = 0;
+   // Sets the owner name, header and footer of the section.
+   virtual void FillContent(unsigned long section_index, ISection& section) = 0;
+
+   virtual unsigned long GetItemCount(unsigned long section_index) = 0;
+   // Sets the items [first, first + count), the item count of the section is already set.
+   virtual void FillItems(unsigned long section_index, unsigned long first, unsigned long count,
+                          ISection& section) = 0;
+};
+
+struct DataSourceOptions
+{
+   DataSourceOptions();
+
+   // Titles of so many sections after the shown ones (revealed by "More") and content of
+   // so many collapsed sections after the expanded ones are pulled in advance.
+   unsigned long m_prefetch_count;
+   // Sections, whose content is kept. The least recently used collapsed sections beyond
+   // it release their content and pull it again, when they are expanded.
+   unsigned long m_cache_size;
+   // Items pulled per section at once. The rest of a longer history is pulled by pages
+   // of this size on request, see StickerModel::PullMoreItems.
+   unsigned long m_item_page_size;
+};
+
+// Data source of a sticker and the record of what has been pulled from it.
+class DataSourceCache
+{
+   DataSourceCache(const DataSourceCache& rhs) = delete;
+
+public:
+   DataSourceCache(std::unique_ptr<IStickerDataSource>&& source, const DataSourceOptions& options);
+
+   IStickerDataSource& GetSource() const;
+   const DataSourceOptions& GetOptions() const;
+
+   // Forgets everything pulled, e.g. the history has changed.
+   void Reset(unsigned long section_count);
+
+   bool IsTitlePulled(unsigned long index) const;
+   void SetTitlePulled(unsigned long index);
+
+   bool IsContentPulled(unsigned long index) const;
+   // Marks content of the section as pulled and the most recently used.
+   void TouchContent(unsigned long index);
+   void ReleaseContent(unsigned long index);
+   // Items [0, count) of the section with pulled content are pulled.
+   unsigned long GetPulledItemCount(unsigned long index) const;
+   void SetPulledItemCount(unsigned long index, unsigned long count);
+   // Sections with content beyond the cache size, the least recently used first. Only
+   // the ones accepted by the predicate (e.g. collapsed) are counted as releasable.
+   template <typename TPredicate>
+   std::vector<unsigned long> GetExcessSections(TPredicate is_releasable) const;
+
+   // In bytes.
+   size_t GetMemorySize() const;
+
+private:
+   typedef std::list<unsigned long> TIndexList;
+
+   struct Content
+   {
+      TIndexList::iterator m_position;   // In m_content_sections
+      unsigned long m_item_count;        // Pulled items
+   };
+
+   std::unique_ptr<IStickerDataSource> m_source;
+   DataSourceOptions m_options;
+   std::vector<bool> m_pulled_titles;
+   // Sections with pulled content, the most recently used first.
+   TIndexList m_content_sections;
+   std::unordered_map<unsigned long, Content> m_contents;
+};
+
+///////////// class DataSourceCache ////////////////
+
+template <typename TPredicate>
+std::vector<unsigned long> DataSourceCache::GetExcessSections(TPredicate is_releasable) const
+{
+   std::vector<unsigned long> sections;
+   if (m_contents.size() <= m_options.m_cache_size)
+   {
+      return sections;
+   }
+
+   const auto excess_count = m_contents.size() - m_options.m_cache_size;
+   for (auto index = m_content_sections.rbegin(); index != m_content_sections.rend() && sections.size() < excess_count; ++index)
+   {
+      if (is_releasable(*index))
+      {
+         sections.push_back(*index);
+      }
+   }
+   return sections;
+}
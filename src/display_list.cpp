@@ -0,0 +1,507 @@
+#include "display_list.h"
+#include "resource_manager.h"
+
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+namespace
+{
+
+//////////// Constants /////////////
+
+const char g_display_list_signature[] = "display-list";
+const auto g_display_list_version = 1;
+
+const char* const g_command_type_names[] = { "fill", "line", "text", "image", "offset", "batch", "end" };
+
+// Commands of a run are replayed with the same brush, pen or style table.
+bool IsSameStyle(const BGO::DisplayList::Command& lhs, const BGO::DisplayList::Command& rhs)
+{
+   using CommandType = BGO::DisplayList::CommandType;
+
+   if (lhs.m_type != rhs.m_type)
+   {
+      return false;
+   }
+   switch (lhs.m_type)
+   {
+      case CommandType::Fill:
+      case CommandType::Line:
+      {
+         return lhs.m_color == rhs.m_color;
+      }
+      case CommandType::Text:
+      {
+         return lhs.m_style_index == rhs.m_style_index;
+      }
+      case CommandType::Image:
+      case CommandType::Offset:
+      case CommandType::BatchBegin:
+      case CommandType::BatchEnd:
+      {
+         return false;
+      }
+   }
+   return false;
+}
+
+// Commands of a batch are sorted by kind, fills first, and then by style.
+std::pair<BGO::DisplayList::CommandType, unsigned long> GetBatchKey(const BGO::DisplayList::Command& command)
+{
+   using CommandType = BGO::DisplayList::CommandType;
+   return std::make_pair(command.m_type, (CommandType::Text == command.m_type) ? command.m_style_index : command.m_color);
+}
+
+// Command, which doesn't cross the replayed rect, doesn't change its pixels.
+bool IsInRect(const BGO::DisplayList::Command& command, Gdiplus::REAL offset_y, const Gdiplus::RectF* rect)
+{
+   if (nullptr == rect)
+   {
+      return true;
+   }
+
+   auto bounds = command.m_rect;
+   bounds.Y += offset_y;
+   if (BGO::DisplayList::CommandType::Line == command.m_type)
+   {
+      // Line is recorded with zero height, its pen covers a pixel around it.
+      bounds.Y -= 1;
+      bounds.Height = 2;
+   }
+   return bounds.IntersectsWith(*rect) == TRUE;
+}
+
+// Draws commands of the same style, so GDI+ objects are looked up once per run.
+void ReplayRun(Gdiplus::Graphics* graphics, const std::vector<const BGO::DisplayList::Command*>& run)
+{
+   using CommandType = BGO::DisplayList::CommandType;
+
+   auto& resource_manager = BGO::ResourceManager::GetInstance();
+   const auto& first = *run.front();
+   switch (first.m_type)
+   {
+      case CommandType::Fill:
+      {
+         std::vector<Gdiplus::RectF> rects;
+         rects.reserve(run.size());
+         for (const auto command : run)
+         {
+            rects.push_back(command->m_rect);
+         }
+         const auto brush = resource_manager.GetBrush(first.m_color);
+         graphics->FillRectangles(brush.get(), rects.data(), static_cast<INT>(rects.size()));
+         break;
+      }
+      case CommandType::Line:
+      {
+         Gdiplus::Pen pen(Gdiplus::Color(first.m_color), 1);
+         for (const auto command : run)
+         {
+            const auto& rect = command->m_rect;
+            graphics->DrawLine(&pen, rect.GetLeft(), rect.GetTop(), rect.GetRight(), rect.GetTop());
+         }
+         break;
+      }
+      case CommandType::Text:
+      {
+         const auto& style_table = resource_manager.GetTextStyleTable(first.m_style_index);
+         for (const auto command : run)
+         {
+            static_cast<const BGO::Text*>(command->m_object)->DrawString(graphics, style_table, command->m_state);
+         }
+         break;
+      }
+      case CommandType::Image:
+      {
+         for (const auto command : run)
+         {
+            command->m_object->Draw(graphics);
+         }
+         break;
+      }
+      case CommandType::Offset:
+      case CommandType::BatchBegin:
+      case CommandType::BatchEnd:
+      {
+         assert(false);
+         break;
+      }
+   }
+}
+
+void SaveText(std::ostream& stream, const std::wstring& text)
+{
+   stream << '"';
+   for (const auto symbol : text)
+   {
+      if (symbol >= L' ' && symbol < 0x7F && symbol != L'"' && symbol != L'\\')
+      {
+         stream << static_cast<char>(symbol);
+      }
+      else
+      {
+         stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned long>(symbol)
+                << std::dec << std::setfill(' ');
+      }
+   }
+   stream << '"';
+}
+
+} // namespace
+
+namespace BGO
+{
+
+///////////// class DisplayList ////////////////
+
+DisplayList::DisplayList() : m_commands(), m_ranges(), m_backdrop(), m_offset_y(0)
+{
+   // no code
+}
+
+void DisplayList::Clear()
+{
+   m_commands.clear();
+   m_ranges.clear();
+   m_backdrop = Backdrop();
+   m_offset_y = 0;
+}
+
+bool DisplayList::IsEmpty() const
+{
+   return m_commands.empty();
+}
+
+const std::vector<DisplayList::Command>& DisplayList::GetCommands() const
+{
+   return m_commands;
+}
+
+void DisplayList::Record(const Object& object)
+{
+   // Under an offset fills are not compared, as they are in different coordinates.
+   const auto backdrop = (0 == m_offset_y) ? m_backdrop : Backdrop();
+   const auto begin = m_commands.size();
+   object.Record(*this);
+   m_ranges[&object] = Range{ begin, m_commands.size(), backdrop };
+
+   // Fills of the object cover only the object, the following siblings are drawn on the old backdrop.
+   m_backdrop = backdrop;
+}
+
+bool DisplayList::Rerecord(const Object& object)
+{
+   const auto found = m_ranges.find(&object);
+   if (found == m_ranges.end())
+   {
+      return false;
+   }
+   const auto range = found->second;
+
+   // The same fills are skipped, as during the first recording.
+   DisplayList list;
+   list.m_backdrop = range.m_backdrop;
+   list.Record(object);
+
+   const auto old_size = range.m_end - range.m_begin;
+   const auto new_size = list.m_commands.size();
+   if (new_size == old_size)
+   {
+      // The usual case of a changed state, the range is overwritten in place.
+      std::copy(list.m_commands.begin(), list.m_commands.end(), m_commands.begin() + range.m_begin);
+   }
+   else
+   {
+      for (auto it = m_ranges.begin(); it != m_ranges.end();)
+      {
+         auto& other = it->second;
+         if (other.m_begin <= range.m_begin && other.m_end >= range.m_end)
+         {
+            // Range of the object itself or of its parent
+            other.m_end = other.m_end - old_size + new_size;
+         }
+         else if (other.m_end <= range.m_begin)
+         {
+            // Ranges before the object stay as they are
+         }
+         else if (other.m_begin >= range.m_end)
+         {
+            other.m_begin = other.m_begin - old_size + new_size;
+            other.m_end = other.m_end - old_size + new_size;
+         }
+         else
+         {
+            // Nested ranges are taken from the new recording below
+            it = m_ranges.erase(it);
+            continue;
+         }
+         ++it;
+      }
+
+      m_commands.erase(m_commands.begin() + range.m_begin, m_commands.begin() + range.m_end);
+      m_commands.insert(m_commands.begin() + range.m_begin, list.m_commands.begin(), list.m_commands.end());
+   }
+
+   for (const auto& nested : list.m_ranges)
+   {
+      auto& nested_range = m_ranges[nested.first];
+      nested_range = nested.second;
+      nested_range.m_begin += range.m_begin;
+      nested_range.m_end += range.m_begin;
+   }
+   return true;
+}
+
+void DisplayList::AddFill(const Gdiplus::RectF& rect, Gdiplus::ARGB color)
+{
+   if (m_backdrop.m_is_set && m_backdrop.m_color == color && 0 == m_offset_y && m_backdrop.m_rect.Contains(rect) == TRUE)
+   {
+      // Redundant with the fill under it
+      return;
+   }
+   m_commands.push_back(Command{ CommandType::Fill, TextStateNone, 0, color, rect, nullptr });
+   m_backdrop = Backdrop{ rect, color, true };
+}
+
+void DisplayList::AddLine(Gdiplus::REAL left, Gdiplus::REAL top, Gdiplus::REAL right, Gdiplus::ARGB color)
+{
+   m_commands.push_back(Command{ CommandType::Line, TextStateNone, 0, color,
+                                 Gdiplus::RectF(left, top, right - left, 0), nullptr });
+}
+
+void DisplayList::AddText(const Text& text, TextStyleIndex style_index, unsigned char state)
+{
+   m_commands.push_back(Command{ CommandType::Text, state, style_index, 0, text.GetBoundary(), &text });
+}
+
+void DisplayList::AddImage(const Image& image)
+{
+   m_commands.push_back(Command{ CommandType::Image, TextStateNone, 0, 0, image.GetBoundary(), &image });
+}
+
+void DisplayList::AddOffset(Gdiplus::REAL offset_y)
+{
+   m_commands.push_back(Command{ CommandType::Offset, TextStateNone, 0, 0, Gdiplus::RectF(0, offset_y, 0, 0), nullptr });
+   m_offset_y += offset_y;
+}
+
+void DisplayList::BeginBatch()
+{
+   m_commands.push_back(Command{ CommandType::BatchBegin, TextStateNone, 0, 0, Gdiplus::RectF(), nullptr });
+}
+
+void DisplayList::EndBatch()
+{
+   m_commands.push_back(Command{ CommandType::BatchEnd, TextStateNone, 0, 0, Gdiplus::RectF(), nullptr });
+}
+
+void DisplayList::Replay(Gdiplus::Graphics* graphics) const
+{
+   Replay(graphics, 0, m_commands.size(), nullptr);
+}
+
+bool DisplayList::Replay(Gdiplus::Graphics* graphics, const Object& object) const
+{
+   // Offsets recorded before the range are not applied, objects are replayed at their boundaries.
+   const auto found = m_ranges.find(&object);
+   if (found == m_ranges.end())
+   {
+      return false;
+   }
+
+   // Own fill of the object might have been skipped, the old look is cleared by the backdrop then.
+   const auto& range = found->second;
+   if (range.m_backdrop.m_is_set)
+   {
+      const auto brush = ResourceManager::GetInstance().GetBrush(range.m_backdrop.m_color);
+      graphics->FillRectangle(brush.get(), object.GetBoundary());
+   }
+   Replay(graphics, range.m_begin, range.m_end, nullptr);
+   return true;
+}
+
+void DisplayList::Replay(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const
+{
+   Replay(graphics, 0, m_commands.size(), &rect);
+}
+
+void DisplayList::Save(std::ostream& stream) const
+{
+   stream << g_display_list_signature << ' ' << g_display_list_version << ' ' << m_commands.size() << '\n';
+
+   for (const auto& command : m_commands)
+   {
+      const auto& rect = command.m_rect;
+      stream << g_command_type_names[static_cast<size_t>(command.m_type)];
+      switch (command.m_type)
+      {
+         case CommandType::Fill:
+         {
+            stream << ' ' << rect.X << ' ' << rect.Y << ' ' << rect.Width << ' ' << rect.Height
+                   << " #" << std::hex << std::setw(8) << std::setfill('0') << command.m_color
+                   << std::dec << std::setfill(' ');
+            break;
+         }
+         case CommandType::Line:
+         {
+            stream << ' ' << rect.GetLeft() << ' ' << rect.GetTop() << ' ' << rect.GetRight()
+                   << " #" << std::hex << std::setw(8) << std::setfill('0') << command.m_color
+                   << std::dec << std::setfill(' ');
+            break;
+         }
+         case CommandType::Text:
+         {
+            stream << ' ' << rect.X << ' ' << rect.Y << ' ' << rect.Width << ' ' << rect.Height
+                   << ' ' << command.m_style_index << ' ' << static_cast<unsigned long>(command.m_state) << ' ';
+            SaveText(stream, static_cast<const Text*>(command.m_object)->GetText());
+            break;
+         }
+         case CommandType::Image:
+         {
+            stream << ' ' << rect.X << ' ' << rect.Y << ' ' << rect.Width << ' ' << rect.Height;
+            break;
+         }
+         case CommandType::Offset:
+         {
+            stream << ' ' << rect.Y;
+            break;
+         }
+         case CommandType::BatchBegin:
+         case CommandType::BatchEnd:
+         {
+            break;
+         }
+      }
+      stream << '\n';
+   }
+}
+
+size_t DisplayList::GetMemorySize() const
+{
+   // Node of the hash map holds the value and the link to the next node.
+   return m_commands.capacity() * sizeof(Command) + m_ranges.bucket_count() * sizeof(void*) +
+          m_ranges.size() * (sizeof(std::pair<const Object*, Range>) + sizeof(void*));
+}
+
+void DisplayList::Replay(Gdiplus::Graphics* graphics, size_t begin, size_t end, const Gdiplus::RectF* rect) const
+{
+   std::vector<const Command*> run;
+   Gdiplus::REAL offset_y = 0;
+
+   for (auto index = begin; index < end;)
+   {
+      const auto& command = m_commands[index];
+      switch (command.m_type)
+      {
+         case CommandType::Fill:
+         case CommandType::Line:
+         case CommandType::Text:
+         case CommandType::Image:
+         {
+            run.clear();
+            if (IsInRect(command, offset_y, rect))
+            {
+               run.push_back(&command);
+            }
+            for (++index; index < end && IsSameStyle(command, m_commands[index]); ++index)
+            {
+               if (IsInRect(m_commands[index], offset_y, rect))
+               {
+                  run.push_back(&m_commands[index]);
+               }
+            }
+            if (!run.empty())
+            {
+               ReplayRun(graphics, run);
+            }
+            break;
+         }
+         case CommandType::Offset:
+         {
+            graphics->TranslateTransform(0, command.m_rect.Y);
+            offset_y += command.m_rect.Y;
+            ++index;
+            break;
+         }
+         case CommandType::BatchBegin:
+         {
+            // Batch, which can't be reordered, is replayed in order, just skipping its markers.
+            const auto batch_end = FindBatchEnd(index, end);
+            index = ReplayBatch(graphics, index + 1, batch_end, offset_y, rect) ? batch_end + 1 : index + 1;
+            break;
+         }
+         case CommandType::BatchEnd:
+         {
+            ++index;
+            break;
+         }
+      }
+   }
+
+   if (offset_y != 0)
+   {
+      graphics->TranslateTransform(0, -offset_y);
+   }
+}
+
+bool DisplayList::ReplayBatch(Gdiplus::Graphics* graphics, size_t begin, size_t end,
+                              Gdiplus::REAL offset_y, const Gdiplus::RectF* rect) const
+{
+   std::vector<const Command*> commands;
+   commands.reserve(end - begin);
+   for (auto index = begin; index < end; ++index)
+   {
+      const auto& command = m_commands[index];
+      if (CommandType::Offset == command.m_type)
+      {
+         return false;
+      }
+      if (command.m_type != CommandType::BatchBegin && command.m_type != CommandType::BatchEnd &&
+          IsInRect(command, offset_y, rect))
+      {
+         commands.push_back(&command);
+      }
+   }
+
+   // Children of the batch don't overlap, a fill can be only under the text or line of the same
+   // child. So the fills are drawn first and the order of the other commands doesn't matter.
+   std::stable_sort(commands.begin(), commands.end(), [](const Command* lhs, const Command* rhs)
+   {
+      return GetBatchKey(*lhs) < GetBatchKey(*rhs);
+   });
+
+   std::vector<const Command*> run;
+   for (auto it = commands.begin(); it != commands.end();)
+   {
+      run.assign(1, *it);
+      for (++it; it != commands.end() && IsSameStyle(*run.front(), **it); ++it)
+      {
+         run.push_back(*it);
+      }
+      ReplayRun(graphics, run);
+   }
+   return true;
+}
+
+size_t DisplayList::FindBatchEnd(size_t index, size_t end) const
+{
+   auto depth = 0UL;
+   for (; index < end; ++index)
+   {
+      const auto type = m_commands[index].m_type;
+      if (CommandType::BatchBegin == type)
+      {
+         ++depth;
+      }
+      else if (CommandType::BatchEnd == type && 0 == --depth)
+      {
+         return index;
+      }
+   }
+   return end;
+}
+
+} // namespace BGO
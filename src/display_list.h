@@ -0,0 +1,105 @@
+#pragma once
+
+#include "graphic_objects.h"
+
+#include <gdiplus.h>
+
+#include <iosfwd>
+#include <vector>
+#include <unordered_map>
+
+namespace BGO
+{
+
+// Drawing commands of an object tree in the drawing order, recorded by Object::Record.
+// Replay draws them without walking the tree and batches neighbouring commands of the
+// same style. Commands of every recorded object form a node range, so an object, which
+// has changed its look (e.g. hovered text), is re-recorded alone. Commands refer to
+// their objects, so the list must be cleared before the objects are destroyed.
+//
+// Fills, which repeat the fill under them (e.g. background of a text on the background
+// of the sticker), are not recorded. Commands of a batch (e.g. a row of a section) are
+// replayed by kind: all its fills, merged by color, and then the rest, grouped by style.
+class DisplayList
+{
+   DisplayList(const DisplayList& rhs) = delete;
+
+public:
+   enum class CommandType : unsigned char { Fill, Line, Text, Image, Offset, BatchBegin, BatchEnd };
+
+   struct Command
+   {
+      CommandType m_type;
+      unsigned char m_state;           // Text: visual state
+      TextStyleIndex m_style_index;    // Text
+      Gdiplus::ARGB m_color;           // Fill, Line
+      Gdiplus::RectF m_rect;           // Line: top is its position, Offset: Y is the vertical offset
+      const Object* m_object;          // Text, Image
+   };
+
+   DisplayList();
+
+   void Clear();
+   bool IsEmpty() const;
+   const std::vector<Command>& GetCommands() const;
+
+   // Records commands of the object as its node range.
+   void Record(const Object& object);
+   // Records the object anew in place of its range. Returns false, if it isn't recorded.
+   bool Rerecord(const Object& object);
+
+   // Called from Object::Record.
+   void AddFill(const Gdiplus::RectF& rect, Gdiplus::ARGB color);
+   void AddLine(Gdiplus::REAL left, Gdiplus::REAL top, Gdiplus::REAL right, Gdiplus::ARGB color);
+   void AddText(const Text& text, TextStyleIndex style_index, unsigned char state);
+   void AddImage(const Image& image);
+   // Moves all following commands vertically, offsets are accumulated.
+   void AddOffset(Gdiplus::REAL offset_y);
+   // Children, recorded inside a batch, must not overlap each other.
+   void BeginBatch();
+   void EndBatch();
+
+   void Replay(Gdiplus::Graphics* graphics) const;
+   // Replays only the range of the object on the fill under it. Returns false, if it isn't recorded.
+   bool Replay(Gdiplus::Graphics* graphics, const Object& object) const;
+   // Replays only the commands crossing the rect, e.g. a damaged strip. The graphics must be
+   // clipped to it, as the replayed commands may reach out of it.
+   void Replay(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const;
+
+   // Human readable dump of the frame, one command per line.
+   void Save(std::ostream& stream) const;
+   // Commands and ranges, in bytes.
+   size_t GetMemorySize() const;
+
+private:
+   // The last fill, which the following commands are drawn on.
+   struct Backdrop
+   {
+      Gdiplus::RectF m_rect;
+      Gdiplus::ARGB m_color;
+      bool m_is_set;
+   };
+
+   struct Range
+   {
+      size_t m_begin;
+      size_t m_end;
+      Backdrop m_backdrop;   // The one the object has been recorded on
+   };
+
+   // Commands outside of the rect are skipped, unless it's null.
+   void Replay(Gdiplus::Graphics* graphics, size_t begin, size_t end, const Gdiplus::RectF* rect) const;
+   // Returns false, if the batch can't be reordered, e.g. because of offsets inside it.
+   bool ReplayBatch(Gdiplus::Graphics* graphics, size_t begin, size_t end,
+                    Gdiplus::REAL offset_y, const Gdiplus::RectF* rect) const;
+   // Index of the end marker of the batch starting at the index, or the end of the range.
+   size_t FindBatchEnd(size_t index, size_t end) const;
+
+private:
+   std::vector<Command> m_commands;
+   std::unordered_map<const Object*, Range> m_ranges;
+   Backdrop m_backdrop;
+   Gdiplus::REAL m_offset_y;
+};
+
+} // namespace BGO
@@ -1,7 +1,11 @@
 ﻿#include "graphic_objects.h"
+#include "resource_manager.h"
+#include "display_list.h"
 
 #include <cstring>
 #include <cassert>
+#include <cmath>
+#include <tuple>
 
 // #define TEST_MODE
 
@@ -30,6 +34,56 @@ std::wstring AsciiToWide(const char* input)
    return std::wstring(output.get(), output.get() + output_size);
 }
 
+BGO::TextStyleParams MakeTextStyleParams(
+   const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
+   unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width,
+   const Gdiplus::Color& clickable_font_color, unsigned long collapsed_font_style,
+   const Gdiplus::Color& collapsed_font_color)
+{
+   BGO::TextStyleParams params;
+   params.m_font_name = font_name;
+   params.m_font_size = font_size;
+   params.m_font_style = font_style;
+   params.m_font_color = font_color.GetValue();
+   params.m_clickable_font_color = clickable_font_color.GetValue();
+   params.m_collapsed_font_style = collapsed_font_style;
+   params.m_collapsed_font_color = collapsed_font_color.GetValue();
+   params.m_back_color = back_color.GetValue();
+   params.m_width = width;
+   params.m_is_wrapped = false;
+   return params;
+}
+
+BGO::TextStyleParams MakeTextStyleParams(
+   const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
+   unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width,
+   const Gdiplus::Color& clickable_font_color)
+{
+   return MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width,
+                              clickable_font_color, font_style, font_color);
+}
+
+BGO::TextStyleParams MakeTextStyleParams(
+   const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
+   unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width)
+{
+   return MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width, font_color);
+}
+
+BGO::TextStyleParams MakeWrappedTextStyleParams(
+   const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
+   unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width)
+{
+   auto params = MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width);
+   params.m_is_wrapped = true;
+   return params;
+}
+
+// Amount of variants kept rasterized per text: a text is switched between hovered and
+// collapsed states, and each of them is drawn with the rendering hints of both render
+// qualities (high and fast). A smaller cache evicts a variant on each such switch.
+const auto g_max_text_cache_entries = 2UL * 2UL * 2UL;
+
 } // namespace
 
 namespace BGO
@@ -67,6 +121,26 @@ void Object::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
    // no code
 }
 
+void Object::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddNode(typeid(*this), sizeof(Object));
+}
+
+void Object::RecordChild(DisplayList& list, const Object& child)
+{
+   list.Record(child);
+}
+
+void Object::BeginRecordBatch(DisplayList& list)
+{
+   list.BeginBatch();
+}
+
+void Object::EndRecordBatch(DisplayList& list)
+{
+   list.EndBatch();
+}
+
 //////// class ObjectWithBackground ////////
 
 ObjectWithBackground::ObjectWithBackground(const Gdiplus::Color& back_color) :
@@ -89,13 +163,142 @@ void ObjectWithBackground::Draw(Gdiplus::Graphics* graphics) const
    }
 }
 
+void ObjectWithBackground::Record(DisplayList& list) const
+{
+   if (GetBoundary().IsEmptyArea() == FALSE)
+   {
+      list.AddFill(GetBoundary(), m_back_color.GetValue());
+   }
+}
+
+/////////// struct TextStyleParams //////////
+
+bool TextStyleParams::operator<(const TextStyleParams& rhs) const
+{
+   return std::tie(m_font_name, m_font_size, m_font_style, m_font_color, m_clickable_font_color,
+                   m_collapsed_font_style, m_collapsed_font_color, m_back_color, m_width, m_is_wrapped) <
+          std::tie(rhs.m_font_name, rhs.m_font_size, rhs.m_font_style, rhs.m_font_color, rhs.m_clickable_font_color,
+                   rhs.m_collapsed_font_style, rhs.m_collapsed_font_color, rhs.m_back_color, rhs.m_width,
+                   rhs.m_is_wrapped);
+}
+
+/////////// struct FontKey //////////
+
+bool FontKey::operator<(const FontKey& rhs) const
+{
+   return std::tie(m_name, m_size, m_style) < std::tie(rhs.m_name, rhs.m_size, rhs.m_style);
+}
+
+bool FontKey::operator==(const FontKey& rhs) const
+{
+   return m_size == rhs.m_size && m_style == rhs.m_style && m_name == rhs.m_name;
+}
+
+/////////// class TextStyle //////////
+
+TextStyle::TextStyle(const TextStyleParams& params) : m_params(params), m_states()
+{
+   for (auto state = 0U; state < TextStateCount; ++state)
+   {
+      auto& style = m_states[state];
+      style.m_font_key.m_name = m_params.m_font_name;
+      style.m_font_key.m_size = m_params.m_font_size;
+
+      if ((state & TextStateCollapsed) != 0)
+      {
+         style.m_font_key.m_style = m_params.m_collapsed_font_style;
+         style.m_font_color.SetValue(m_params.m_collapsed_font_color);
+      }
+      else
+      {
+         style.m_font_key.m_style = m_params.m_font_style;
+         style.m_font_color.SetValue(((state & TextStateClickable) != 0) ?
+                                     m_params.m_clickable_font_color : m_params.m_font_color);
+      }
+
+      if ((state & TextStateHovered) != 0)
+      {
+         style.m_font_key.m_style |= Gdiplus::FontStyleUnderline;
+      }
+   }
+}
+
+const TextStyleParams& TextStyle::GetParams() const
+{
+   return m_params;
+}
+
+const FontKey& TextStyle::GetFontKey(unsigned char state) const
+{
+   return m_states[state].m_font_key;
+}
+
+const Gdiplus::Color& TextStyle::GetFontColor(unsigned char state) const
+{
+   return m_states[state].m_font_color;
+}
+
+Gdiplus::Color TextStyle::GetBackColor() const
+{
+   return Gdiplus::Color(m_params.m_back_color);
+}
+
+unsigned long TextStyle::GetWidth() const
+{
+   return m_params.m_width;
+}
+
+bool TextStyle::IsWrapped() const
+{
+   return m_params.m_is_wrapped;
+}
+
+/////////// class TextStyleTable //////////
+
+TextStyleTable::TextStyleTable(const TextStyle& style) : m_states(), m_back_brush()
+{
+   auto& resource_manager = ResourceManager::GetInstance();
+
+   for (auto state = 0U; state < TextStateCount; ++state)
+   {
+      m_states[state].m_font = resource_manager.GetFont(style.GetFontKey(state));
+      m_states[state].m_brush = resource_manager.GetBrush(style.GetFontColor(state).GetValue());
+   }
+   m_back_brush = resource_manager.GetBrush(style.GetParams().m_back_color);
+}
+
+const Gdiplus::Font* TextStyleTable::GetFont(unsigned char state) const
+{
+   return m_states[state].m_font.get();
+}
+
+const Gdiplus::Brush* TextStyleTable::GetBrush(unsigned char state) const
+{
+   return m_states[state].m_brush.get();
+}
+
+const Gdiplus::Brush* TextStyleTable::GetBackBrush() const
+{
+   return m_back_brush.get();
+}
+
 ///////////// class Text /////////////
+
+// Texts are the most numerous nodes (three per section item). Besides the object itself a text
+// keeps only its string, metrics, bitmap cache and a few bytes of style index and state.
+static_assert(sizeof(Text) <= sizeof(Object) + sizeof(std::wstring) + sizeof(std::shared_ptr<const TextMetrics>) +
+                              sizeof(std::vector<int>) + sizeof(void*), "Text keeps per-node style data");
    
 Text::Text(const Gdiplus::Color& back_color, const wchar_t* font_name, 
            unsigned long font_size, unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width) :
-   ObjectWithBackground(back_color),
-   m_font_name(font_name), m_font_size(font_size),
-   m_font_style(font_style), m_font_color(font_color), m_width(width)
+   Text(::MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width), TextStateNone)
+{
+   // no code
+}
+
+Text::Text(const TextStyleParams& params, unsigned char state) : Object(),
+   m_text(), m_metrics(), m_cache(),
+   m_style_index(ResourceManager::GetInstance().GetTextStyleIndex(params)), m_state(state)
 {
    // no code
 }
@@ -106,6 +309,8 @@ bool Text::SetText(const char* text)
    if (m_text != wide_text)
    {
       m_text = wide_text;
+      m_metrics.reset();
+      InvalidateCache();
       return true;
    }
    return false;
@@ -113,18 +318,67 @@ bool Text::SetText(const char* text)
 
 bool Text::SetColor(const Gdiplus::Color& color)
 {
-   if (std::memcmp(&m_font_color, &color, sizeof(Gdiplus::Color)) != 0)
+   auto& resource_manager = ResourceManager::GetInstance();
+   const auto& style = resource_manager.GetTextStyle(m_style_index);
+   if (style.GetParams().m_font_color != color.GetValue())
    {
-      m_font_color = color;
+      auto params = style.GetParams();
+      params.m_font_color = color.GetValue();
+      m_style_index = resource_manager.GetTextStyleIndex(params);
+      InvalidateCache();
       return true;
    }
    return false;
 }
 
+bool Text::SetWidth(unsigned long width)
+{
+   auto& resource_manager = ResourceManager::GetInstance();
+   const auto& style = resource_manager.GetTextStyle(m_style_index);
+   if (style.GetWidth() != width)
+   {
+      auto params = style.GetParams();
+      params.m_width = width;
+      m_style_index = resource_manager.GetTextStyleIndex(params);
+      return true;
+   }
+   return false;
+}
+
+const std::wstring& Text::GetText() const
+{
+   return m_text;
+}
+
+void Text::DrawString(Gdiplus::Graphics* graphics, const TextStyleTable& style_table, unsigned char state) const
+{
+   if (m_metrics && !m_metrics->m_lines.empty())
+   {
+      // Wrapped text is drawn line by line, as it has been broken during layout.
+      auto line_y = m_boundary.Y;
+      for (const auto& line : m_metrics->m_lines)
+      {
+         graphics->DrawString(m_text.c_str() + line.m_start, line.m_length, style_table.GetFont(state),
+                              Gdiplus::PointF(m_boundary.X, line_y),
+                              Gdiplus::StringFormat::GenericTypographic(), style_table.GetBrush(state));
+         line_y += m_metrics->m_line_height;
+      }
+   }
+   else
+   {
+      graphics->DrawString(m_text.c_str(), m_text.size(), style_table.GetFont(state),
+                           m_boundary, nullptr, style_table.GetBrush(state));
+   }
+}
+
 void Text::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
 {
-   Gdiplus::RectF origin_rect(x, y, m_width, 0);
-   Gdiplus::Font font(GetFontName(), GetFontSize(), GetFontStyle());
+   const auto& style = ResourceManager::GetInstance().GetTextStyle(m_style_index);
+   const auto width = style.GetWidth();
+   Gdiplus::RectF origin_rect(x, y, width, 0);
+
+   const auto old_width = m_boundary.Width;
+   const auto old_height = m_boundary.Height;
 
    if (m_text.empty())
    {
@@ -132,44 +386,162 @@ void Text::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphi
    }
    else
    {
-      graphics->MeasureString(m_text.c_str(), m_text.size(), &font, origin_rect, &m_boundary);
-      if (m_width > 0 && m_boundary.Width < m_width)
+      // Measurement is shared by all texts with the same string and style.
+      const auto& font_key = style.GetFontKey(m_state);
+      const auto dpi = graphics->GetDpiX();
+      const auto rendering_hint = graphics->GetTextRenderingHint();
+      const auto is_wrapped = style.IsWrapped();
+      if (!m_metrics || !m_metrics->IsMeasuredFor(font_key, width, dpi, rendering_hint, is_wrapped))
       {
-         m_boundary.Width = m_width;
+         const TextMetricsKey key = { m_text, font_key, width, dpi, rendering_hint, is_wrapped };
+         m_metrics = ResourceManager::GetInstance().GetTextMetrics(key, graphics);
       }
+
+      m_boundary = Gdiplus::RectF(x, y, m_metrics->m_width, m_metrics->m_height);
+      if (width > 0 && m_boundary.Width < width)
+      {
+         m_boundary.Width = width;
+      }
+   }
+
+   // Moving of the text doesn't spoil rasterized bitmaps, but resizing does.
+   if (old_width != m_boundary.Width || old_height != m_boundary.Height)
+   {
+      InvalidateCache();
    }
 }
 
 void Text::Draw(Gdiplus::Graphics* graphics) const
 {
-   ObjectWithBackground::Draw(graphics);
+   if (GetBoundary().IsEmptyArea() == FALSE)
+   {
+      // Bitmap is blitted to the whole pixel, while fractional part of
+      // the position is taken into account during rasterization.
+      const auto left = std::floor(m_boundary.X);
+      const auto top = std::floor(m_boundary.Y);
+
+      auto bitmap = GetRenderedText(graphics, m_state, m_boundary.X - left, m_boundary.Y - top);
+      graphics->DrawImage(bitmap, static_cast<INT>(left), static_cast<INT>(top),
+                          static_cast<INT>(bitmap->GetWidth()), static_cast<INT>(bitmap->GetHeight()));
+   }
+}
 
+void Text::Record(DisplayList& list) const
+{
    if (GetBoundary().IsEmptyArea() == FALSE)
    {
-      Gdiplus::Font font(GetFontName(), GetFontSize(), GetFontStyle());
-      Gdiplus::SolidBrush brush(GetFontColor());
-      graphics->DrawString(m_text.c_str(), m_text.size(), &font, m_boundary, nullptr, &brush);
+      const auto& style = ResourceManager::GetInstance().GetTextStyle(m_style_index);
+      list.AddFill(m_boundary, style.GetParams().m_back_color);
+      list.AddText(*this, m_style_index, m_state);
+   }
+}
+
+void Text::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddNode(typeid(*this), sizeof(Text));
+   usage.AddStrings(MemoryUsage::GetStringSize(m_text));
+
+   size_t cache_bytes = m_cache.capacity() * sizeof(CacheEntry);
+   for (const auto& entry : m_cache)
+   {
+      cache_bytes += MemoryUsage::GetBitmapSize(entry.m_bitmap.get());
    }
+   usage.AddCaches(cache_bytes);
+}
+
+bool Text::HasState(unsigned char state) const
+{
+   return (m_state & state) != 0;
 }
 
-const wchar_t* Text::GetFontName() const
+bool Text::SetState(unsigned char state, bool is_set)
 {
-   return m_font_name;
+   const unsigned char new_state = is_set ? (m_state | state) : (m_state & ~state);
+   if (new_state != m_state)
+   {
+      m_state = new_state;
+      return true;
+   }
+   return false;
 }
 
-unsigned long Text::GetFontSize() const
+void Text::PrerenderToggledState(Gdiplus::Graphics* graphics, unsigned char state) const
 {
-   return m_font_size;
+   if (GetBoundary().IsEmptyArea() == FALSE)
+   {
+      // Same offsets as in Draw, so the rendered variant is found by it.
+      GetRenderedText(graphics, m_state ^ state,
+                      m_boundary.X - std::floor(m_boundary.X), m_boundary.Y - std::floor(m_boundary.Y));
+   }
 }
 
-unsigned long Text::GetFontStyle() const
+void Text::InvalidateCache()
 {
-   return m_font_style;
+   m_cache.clear();
+}
+
+Gdiplus::Bitmap* Text::GetRenderedText(Gdiplus::Graphics* graphics, unsigned char state,
+                                       Gdiplus::REAL offset_x, Gdiplus::REAL offset_y) const
+{
+   const auto rendering_hint = graphics->GetTextRenderingHint();
+
+   CacheEntry* cache_entry = nullptr;
+   for (auto& entry : m_cache)
+   {
+      if (entry.m_state == state && entry.m_rendering_hint == rendering_hint)
+      {
+         if (entry.m_offset_x == offset_x && entry.m_offset_y == offset_y)
+         {
+            return entry.m_bitmap.get();
+         }
+         cache_entry = &entry;
+         break;
+      }
+   }
+
+   if (nullptr == cache_entry)
+   {
+      if (m_cache.size() >= g_max_text_cache_entries)
+      {
+         m_cache.erase(m_cache.begin());
+      }
+      m_cache.emplace_back();
+      cache_entry = &m_cache.back();
+   }
+
+   const auto width = static_cast<INT>(std::ceil(offset_x + m_boundary.Width));
+   const auto height = static_cast<INT>(std::ceil(offset_y + m_boundary.Height));
+
+   std::unique_ptr<Gdiplus::Bitmap> bitmap(new Gdiplus::Bitmap(width, height, PixelFormat32bppPARGB));
+   bitmap->SetResolution(graphics->GetDpiX(), graphics->GetDpiY());
+   {
+      Gdiplus::Graphics bitmap_graphics(bitmap.get());
+      bitmap_graphics.SetTextRenderingHint(rendering_hint);
+      bitmap_graphics.TranslateTransform(offset_x - m_boundary.X, offset_y - m_boundary.Y);
+
+      // GDI+ objects are needed on cache misses only, so they are looked up here.
+      const auto& style_table = ResourceManager::GetInstance().GetTextStyleTable(m_style_index);
+      bitmap_graphics.FillRectangle(style_table.GetBackBrush(), m_boundary);
+      DrawString(&bitmap_graphics, style_table, state);
+   }
+
+   cache_entry->m_state = state;
+   cache_entry->m_rendering_hint = rendering_hint;
+   cache_entry->m_offset_x = offset_x;
+   cache_entry->m_offset_y = offset_y;
+   cache_entry->m_bitmap = std::move(bitmap);
+
+   return cache_entry->m_bitmap.get();
 }
 
-const Gdiplus::Color& Text::GetFontColor() const
+/////////// class WrappedText //////////
+
+WrappedText::WrappedText(
+   const Gdiplus::Color& back_color, const wchar_t* font_name,
+   unsigned long font_size, unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width) :
+      Text(::MakeWrappedTextStyleParams(back_color, font_name, font_size, font_style, font_color, width), TextStateNone)
 {
-   return m_font_color;
+   // no code
 }
 
 /////////// class HoverableText //////////
@@ -177,30 +549,43 @@ const Gdiplus::Color& Text::GetFontColor() const
 HoverableText::HoverableText(
    const Gdiplus::Color& back_color, const wchar_t* font_name,
    unsigned long font_size, unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width) :
-      Text(back_color, font_name, font_size, font_style, font_color, width), m_is_hovered(false)
+      HoverableText(::MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width), TextStateNone)
 {
    // no code
 }
 
-void HoverableText::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
+HoverableText::HoverableText(const TextStyleParams& params, unsigned char state) :
+   Text(params, state)
 {
-   const auto does_contain_cursor = (GetBoundary().Contains(x, y) == TRUE);
-   if (does_contain_cursor != m_is_hovered)
+   // no code
+}
+
+void HoverableText::Draw(Gdiplus::Graphics* graphics) const
+{
+   Text::Draw(graphics);
+   if (IsHoverable())
    {
-      m_is_hovered = does_contain_cursor;
-      invalidated_objects.push_back(this);
+      PrerenderToggledState(graphics, TextStateHovered);
    }
 }
 
-unsigned long HoverableText::GetFontStyle() const
+void HoverableText::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
 {
-   const auto font_style = GetFontStyleWithoutHover();
-   return m_is_hovered ? (font_style | Gdiplus::FontStyleUnderline) : font_style;
+   if (!IsHoverable())
+   {
+      return;
+   }
+
+   const auto does_contain_cursor = (GetBoundary().Contains(x, y) == TRUE);
+   if (SetState(TextStateHovered, does_contain_cursor))
+   {
+      invalidated_objects.push_back(this);
+   }
 }
 
-unsigned long HoverableText::GetFontStyleWithoutHover() const
+bool HoverableText::IsHoverable() const
 {
-   return Text::GetFontStyle();
+   return true;
 }
 
 /////////// class ClickableText ////////////
@@ -209,42 +594,30 @@ ClickableText::ClickableText(
    const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
    unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width,
    const Gdiplus::Color& clickable_font_color) :
-      HoverableText(back_color, font_name, font_size, font_style, font_color, width),
-      m_clickable_font_color(clickable_font_color), m_is_clickable(true)
+      HoverableText(::MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width,
+                                          clickable_font_color),
+                    TextStateClickable)
 {
    // no code
 }
 
 bool ClickableText::SetClickable(bool is_clickable)
 {
-   if (is_clickable != m_is_clickable)
-   {
-      m_is_clickable = is_clickable;
-      return true;
-   }
-   return false;
+   return SetState(TextStateClickable, is_clickable);
 }
 
 Object::ClickType ClickableText::ProcessClick(long x, long y, TULongVector& group_indexes)
 {
-   if (m_is_clickable)
+   if (HasState(TextStateClickable))
    {
       return (GetBoundary().Contains(x, y) == TRUE) ? ClickType::ClickDone : ClickType::NoClick;
    }
    return ClickType::NoClick;
 }
 
-void ClickableText::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
-{
-   if (m_is_clickable)
-   {
-      HoverableText::ProcessHover(x, y, invalidated_objects);
-   }
-}
-
-const Gdiplus::Color& ClickableText::GetFontColor() const
+bool ClickableText::IsHoverable() const
 {
-   return m_is_clickable ? m_clickable_font_color : HoverableText::GetFontColor();
+   return HasState(TextStateClickable);
 }
 
 ///////////// class CollapsibleText ////////////////
@@ -253,42 +626,33 @@ CollapsibleText::CollapsibleText(
    const Gdiplus::Color& back_color, const wchar_t* font_name, unsigned long font_size,
    unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width,
    unsigned long collapsed_font_style, const Gdiplus::Color& collapsed_font_color) :
-      HoverableText(back_color, font_name, font_size, font_style, font_color, width),
-      m_collapsed_font_style(collapsed_font_style), m_collapsed_font_color(collapsed_font_color), m_is_collapsed(true)
+      HoverableText(::MakeTextStyleParams(back_color, font_name, font_size, font_style, font_color, width,
+                                          font_color, collapsed_font_style, collapsed_font_color),
+                    TextStateCollapsed)
 {
    // no code
 }
 
 void CollapsibleText::SetCollapsed(bool is_collapsed)
 {
-   m_is_collapsed = is_collapsed;
+   SetState(TextStateCollapsed, is_collapsed);
 }
 
 bool CollapsibleText::GetCollapsed() const
 {
-   return m_is_collapsed;
+   return HasState(TextStateCollapsed);
 }
 
 Object::ClickType CollapsibleText::ProcessClick(long x, long y, TULongVector& group_indexes)
 {
    if (GetBoundary().Contains(x, y) == TRUE)
    {
-      m_is_collapsed = !m_is_collapsed;
+      SetState(TextStateCollapsed, !GetCollapsed());
       return ClickType::ClickDoneNeedResize;
    }
    return ClickType::NoClick;
 }
 
-unsigned long CollapsibleText::GetFontStyleWithoutHover() const
-{
-   return m_is_collapsed ? m_collapsed_font_style : HoverableText::GetFontStyleWithoutHover();
-}
-
-const Gdiplus::Color& CollapsibleText::GetFontColor() const
-{
-   return m_is_collapsed ? m_collapsed_font_color : HoverableText::GetFontColor();
-}
-
 ///////////// class Line ////////////////
 
 Line::Line(const Gdiplus::Color& back_color, const Gdiplus::Color& color, unsigned long width) :
@@ -297,6 +661,16 @@ Line::Line(const Gdiplus::Color& back_color, const Gdiplus::Color& color, unsign
    // no code
 }
 
+bool Line::SetWidth(unsigned long width)
+{
+   if (m_width != width)
+   {
+      m_width = width;
+      return true;
+   }
+   return false;
+}
+
 void Line::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
 {
    m_boundary.X = x;
@@ -322,26 +696,114 @@ void Line::Draw(Gdiplus::Graphics* graphics) const
                       m_boundary.GetRight(), m_boundary.GetTop() + 1);
 }
 
+void Line::Record(DisplayList& list) const
+{
+   ObjectWithBackground::Record(list);
+
+   // The same two lines as in Draw
+   const Gdiplus::Color shadow_color(m_color.GetA()/2, m_color.GetR(), m_color.GetG(), m_color.GetB());
+   list.AddLine(m_boundary.GetLeft(), m_boundary.GetTop(), m_boundary.GetRight(), m_color.GetValue());
+   list.AddLine(m_boundary.GetLeft(), m_boundary.GetTop() + 1, m_boundary.GetRight(), shadow_color.GetValue());
+}
+
+void Line::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddNode(typeid(*this), sizeof(Line));
+}
+
+///////////// class ImageAtlas ////////////////
+
+ImageAtlas::ImageAtlas(unsigned long image_width, unsigned long image_height, unsigned long image_count) :
+   m_image_width(image_width), m_image_height(image_height), m_image_count(image_count),
+   m_bitmap(new Gdiplus::Bitmap(image_width * image_count, image_height, PixelFormat32bppPARGB))
+{
+   // no code
+}
+
+unsigned long ImageAtlas::GetImageWidth() const
+{
+   return m_image_width;
+}
+
+unsigned long ImageAtlas::GetImageHeight() const
+{
+   return m_image_height;
+}
+
+unsigned long ImageAtlas::GetImageCount() const
+{
+   return m_image_count;
+}
+
+std::unique_ptr<Gdiplus::Graphics> ImageAtlas::GetImageGraphics(unsigned long index)
+{
+   assert(index < m_image_count);
+
+   std::unique_ptr<Gdiplus::Graphics> graphics(Gdiplus::Graphics::FromImage(m_bitmap.get()));
+   graphics->SetClip(Gdiplus::Rect(index * m_image_width, 0, m_image_width, m_image_height));
+   graphics->TranslateTransform(static_cast<Gdiplus::REAL>(index * m_image_width), 0);
+   return graphics;
+}
+
+void ImageAtlas::Draw(Gdiplus::Graphics* graphics, unsigned long index, Gdiplus::REAL x, Gdiplus::REAL y) const
+{
+   assert(index < m_image_count);
+
+   const Gdiplus::Rect dest_rect(static_cast<INT>(std::floor(x)), static_cast<INT>(std::floor(y)),
+                                 m_image_width, m_image_height);
+   graphics->DrawImage(m_bitmap.get(), dest_rect, index * m_image_width, 0,
+                       m_image_width, m_image_height, Gdiplus::UnitPixel);
+}
+
 ///////////// class Image ////////////////
 
-Image::Image(/*int resouse_id*/) : Object()
+Image::Image(const std::shared_ptr<const ImageAtlas>& atlas) :
+   Object(), m_atlas(atlas), m_index(NoImage)
 {
-   // TODO: Load from resoure
+   // no code
+}
+
+bool Image::SetIndex(long index)
+{
+   assert(NoImage == index || (index >= 0 && static_cast<unsigned long>(index) < m_atlas->GetImageCount()));
+
+   if (m_index != index)
+   {
+      m_index = index;
+      return true;
+   }
+   return false;
 }
 
 void Image::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
 {
-   // TODO: Get rectangle from the image
+   // Width is reserved even without image, so the columns of rows stay aligned.
    m_boundary.X = x;
    m_boundary.Y = y;
-   m_boundary.Width = 10;
-   m_boundary.Height = 0; //10;
+   m_boundary.Width = m_atlas->GetImageWidth();
+   m_boundary.Height = (NoImage == m_index) ? 0 : m_atlas->GetImageHeight();
 }
 
 void Image::Draw(Gdiplus::Graphics* graphics) const
 {
-   // TODO: Draw the image
-   graphics;
+   if (m_index != NoImage)
+   {
+      m_atlas->Draw(graphics, m_index, m_boundary.X, m_boundary.Y);
+   }
+}
+
+void Image::Record(DisplayList& list) const
+{
+   if (m_index != NoImage)
+   {
+      list.AddImage(*this);
+   }
+}
+
+void Image::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   // The atlas is shared by all images.
+   usage.AddNode(typeid(*this), sizeof(Image));
 }
 
 ///////////// class Group ////////////////
@@ -405,6 +867,12 @@ void Group::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graph
    m_boundary.Width = 0;
    m_boundary.Height = 0;
 
+   // Group without objects, e.g. items of an empty section, takes no place.
+   if (m_object_infos.empty())
+   {
+      return;
+   }
+
    Gdiplus::REAL start_x = x + m_indent_before_x;
    Gdiplus::REAL start_y = y + m_indent_before_y;
 
@@ -499,6 +967,17 @@ void Group::Draw(Gdiplus::Graphics* graphics) const
 #endif // TEST_MODE
 }
 
+void Group::Record(DisplayList& list) const
+{
+   for (auto index = 0UL; index < m_object_infos.size(); ++index)
+   {
+      if (IsObjectVisible(index))
+      {
+         list.Record(*m_object_infos[index].m_object);
+      }
+   }
+}
+
 Object::ClickType Group::ProcessClick(long x, long y, TULongVector& group_indexes)
 {
    for (auto index = 0UL; index < m_object_infos.size(); ++index)
@@ -528,9 +1007,211 @@ void Group::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
    }
 }
 
+void Group::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddNode(typeid(*this), sizeof(Group));
+   CollectChildrenMemoryUsage(usage);
+}
+
 bool Group::IsObjectVisible(unsigned long index) const
 {
    return true;
 }
 
+void Group::CollectChildrenMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddChildVectors(m_object_infos.capacity() * sizeof(ObjectInfo));
+   for (const auto& object_info : m_object_infos)
+   {
+      if (object_info.m_object)
+      {
+         object_info.m_object->CollectMemoryUsage(usage);
+      }
+   }
+}
+
+///////////// class LayeredGroup ////////////////
+
+LayeredGroup::LayeredGroup(GroupType type, Gdiplus::REAL indent_before_x, Gdiplus::REAL indent_before_y) :
+   Group(type, indent_before_x, indent_before_y), m_layer(),
+   m_layer_rendering_hint(Gdiplus::TextRenderingHintSystemDefault), m_layer_phase(), m_is_layer_valid(false), m_is_layer_caching(true),
+   m_draw_offset_y(0)
+{
+   // no code
+}
+
+void LayeredGroup::InvalidateLayer()
+{
+   m_is_layer_valid = false;
+}
+
+void LayeredGroup::SetLayerCaching(bool is_enabled)
+{
+   if (m_is_layer_caching != is_enabled)
+   {
+      m_is_layer_caching = is_enabled;
+      m_layer.reset();
+      InvalidateLayer();
+   }
+}
+
+void LayeredGroup::SetDrawOffset(Gdiplus::REAL offset_y)
+{
+   m_draw_offset_y = offset_y;
+}
+
+Gdiplus::REAL LayeredGroup::GetDrawOffset() const
+{
+   return m_draw_offset_y;
+}
+
+void LayeredGroup::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
+{
+   const auto old_width = m_boundary.Width;
+   const auto old_height = m_boundary.Height;
+
+   Group::RecalculateBoundary(x, y, graphics);
+
+   if (old_width != m_boundary.Width || old_height != m_boundary.Height)
+   {
+      InvalidateLayer();
+   }
+}
+
+void LayeredGroup::Draw(Gdiplus::Graphics* graphics) const
+{
+   if (GetBoundary().IsEmptyArea() == TRUE)
+   {
+      return;
+   }
+
+   if (!m_is_layer_caching)
+   {
+      graphics->TranslateTransform(0, m_draw_offset_y);
+      DrawLayer(graphics);
+      graphics->TranslateTransform(0, -m_draw_offset_y);
+      return;
+   }
+
+   const auto origin = GetLayerOrigin();
+   const auto width = static_cast<INT>(std::ceil(m_boundary.GetRight() - origin.X));
+   const auto height = static_cast<INT>(std::ceil(m_boundary.GetBottom() - origin.Y));
+   const Gdiplus::PointF phase(m_boundary.X - origin.X, m_boundary.Y - origin.Y);
+
+   // Moving by whole pixels is just a blit to other place. Layer is rendered anew for other
+   // text quality as well, e.g. when the sticker settles after animation.
+   if (!m_is_layer_valid || !m_layer || m_layer_rendering_hint != graphics->GetTextRenderingHint() ||
+       m_layer_phase.Equals(phase) == FALSE ||
+       m_layer->GetWidth() != static_cast<UINT>(width) || m_layer->GetHeight() != static_cast<UINT>(height))
+   {
+      m_layer.reset(new Gdiplus::Bitmap(width, height, PixelFormat32bppPARGB));
+      m_layer->SetResolution(graphics->GetDpiX(), graphics->GetDpiY());
+
+      m_layer_rendering_hint = graphics->GetTextRenderingHint();
+      m_layer_phase = phase;
+      Gdiplus::Graphics layer_graphics(m_layer.get());
+      layer_graphics.SetTextRenderingHint(m_layer_rendering_hint);
+      layer_graphics.TranslateTransform(-origin.X, -origin.Y);
+      DrawLayer(&layer_graphics);
+
+      m_is_layer_valid = true;
+   }
+
+   graphics->DrawImage(m_layer.get(), static_cast<INT>(origin.X),
+                       static_cast<INT>(origin.Y + m_draw_offset_y), width, height);
+}
+
+void LayeredGroup::Record(DisplayList& list) const
+{
+   // Display list is the cache itself, so the layer isn't used for it.
+   if (GetBoundary().IsEmptyArea() == TRUE)
+   {
+      return;
+   }
+
+   if (m_draw_offset_y != 0)
+   {
+      list.AddOffset(m_draw_offset_y);
+   }
+   RecordLayer(list);
+   if (m_draw_offset_y != 0)
+   {
+      list.AddOffset(-m_draw_offset_y);
+   }
+}
+
+Object::ClickType LayeredGroup::ProcessClick(long x, long y, TULongVector& group_indexes)
+{
+   const auto click = Group::ProcessClick(x, y, group_indexes);
+   if (ClickType::ClickDoneNeedResize == click)
+   {
+      InvalidateLayer();
+   }
+   return click;
+}
+
+void LayeredGroup::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
+{
+   const auto invalidated_count = invalidated_objects.size();
+   Group::ProcessHover(x, y, invalidated_objects);
+   if (invalidated_objects.size() == invalidated_count || !m_is_layer_valid || !m_layer)
+   {
+      return;
+   }
+
+   // Objects laid out outside of the layer would leave a shifted copy in it,
+   // so the layer is rendered anew, when it's shown next time.
+   if (!IsLayerShown())
+   {
+      InvalidateLayer();
+      return;
+   }
+   for (auto index = invalidated_count; index < invalidated_objects.size(); ++index)
+   {
+      if (m_boundary.Contains(invalidated_objects[index]->GetBoundary()) == FALSE)
+      {
+         InvalidateLayer();
+         return;
+      }
+   }
+
+   // Hovered objects are patched in the layer instead of re-rendering it,
+   // their pre-rendered variants make it a blit.
+   const auto origin = GetLayerOrigin();
+   Gdiplus::Graphics layer_graphics(m_layer.get());
+   layer_graphics.SetTextRenderingHint(m_layer_rendering_hint);
+   layer_graphics.TranslateTransform(-origin.X, -origin.Y);
+   for (auto index = invalidated_count; index < invalidated_objects.size(); ++index)
+   {
+      invalidated_objects[index]->Draw(&layer_graphics);
+   }
+}
+
+void LayeredGroup::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   usage.AddNode(typeid(*this), sizeof(LayeredGroup));
+   usage.AddCaches(MemoryUsage::GetBitmapSize(m_layer.get()));
+   CollectChildrenMemoryUsage(usage);
+}
+
+void LayeredGroup::DrawLayer(Gdiplus::Graphics* graphics) const
+{
+   Group::Draw(graphics);
+}
+
+void LayeredGroup::RecordLayer(DisplayList& list) const
+{
+   Group::Record(list);
+}
+
+bool LayeredGroup::IsLayerShown() const
+{
+   return true;
+}
+
+Gdiplus::PointF LayeredGroup::GetLayerOrigin() const
+{
+   return Gdiplus::PointF(std::floor(m_boundary.X), std::floor(m_boundary.Y));
+}
+
 } // namespace BGO
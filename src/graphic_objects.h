@@ -1,4 +1,6 @@
-﻿#pragma one
+﻿#pragma once
+
+#include "memory_usage.h"
 
 #include <windows.h>
 #include <gdiplus.h>
@@ -6,11 +8,15 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <type_traits>
 
 namespace BGO
 {
 
 class Object;
+class DisplayList;
 
 using TObjectPtrVector = std::vector<Object*>;
 using TULongVector = std::deque<unsigned long>;
@@ -28,11 +34,24 @@ public:
    virtual void OffsetBoundary(Gdiplus::REAL offset_x, Gdiplus::REAL offset_y);
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) = 0;
    virtual void Draw(Gdiplus::Graphics* graphics) const = 0;
+   // Adds the same drawing as Draw does to the display list, children are recorded
+   // by DisplayList::Record, so they get own ranges.
+   virtual void Record(DisplayList& list) const = 0;
    
    enum class ClickType { NoClick, ClickDone, ClickDoneNeedResize };
    virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes);
    virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects);
 
+   // Adds memory of the object and its children. Derived classes with own
+   // members add their size to the node (or override it to add owned memory).
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const;
+
+protected:
+   // For templates, which can't use the incomplete DisplayList.
+   static void RecordChild(DisplayList& list, const Object& child);
+   static void BeginRecordBatch(DisplayList& list);
+   static void EndRecordBatch(DisplayList& list);
+
 protected:
    Gdiplus::RectF m_boundary;
 };
@@ -44,12 +63,106 @@ public:
 
    // Object overrides
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
 
 private:
    Gdiplus::Color m_back_color;
 };
 
-class Text : public ObjectWithBackground
+// Flags of the visual text state. Their combination indexes styles of TextStyle.
+enum TextState : unsigned char
+{
+   TextStateNone = 0x00,
+   TextStateHovered = 0x01,
+   TextStateClickable = 0x02,
+   TextStateCollapsed = 0x04,
+   TextStateCount = 0x08
+};
+
+// Everything, which defines how text of some class looks in all its states.
+struct TextStyleParams
+{
+   std::wstring m_font_name;
+   unsigned long m_font_size;
+   unsigned long m_font_style;
+   Gdiplus::ARGB m_font_color;
+   Gdiplus::ARGB m_clickable_font_color;
+   unsigned long m_collapsed_font_style;
+   Gdiplus::ARGB m_collapsed_font_color;
+   Gdiplus::ARGB m_back_color;
+   unsigned long m_width;
+   bool m_is_wrapped;
+
+   bool operator<(const TextStyleParams& rhs) const;
+};
+
+struct FontKey
+{
+   std::wstring m_name;
+   unsigned long m_size;
+   unsigned long m_style;
+
+   bool operator<(const FontKey& rhs) const;
+   bool operator==(const FontKey& rhs) const;
+};
+
+// Index of a text style, see ResourceManager::GetTextStyleIndex. Each width and color
+// of a text registers a style, so the index isn't shorter than the padding after it.
+using TextStyleIndex = unsigned int;
+
+// Immutable look of text of some class in all its states. Styles are plain data,
+// registered once per process and referenced by texts through TextStyleIndex.
+class TextStyle
+{
+public:
+   TextStyle(const TextStyleParams& params);
+
+   const TextStyleParams& GetParams() const;
+   const FontKey& GetFontKey(unsigned char state) const;
+   const Gdiplus::Color& GetFontColor(unsigned char state) const;
+   Gdiplus::Color GetBackColor() const;
+   unsigned long GetWidth() const;
+   bool IsWrapped() const;
+
+private:
+   struct State
+   {
+      FontKey m_font_key;
+      Gdiplus::Color m_font_color;
+   };
+
+   TextStyleParams m_params;
+   State m_states[TextStateCount];
+};
+
+// GDI+ objects, drawing text of one style in all its states. Tables are
+// created per thread, as GDI+ objects can't be shared between threads.
+class TextStyleTable
+{
+   TextStyleTable(const TextStyleTable& rhs) = delete;
+
+public:
+   TextStyleTable(const TextStyle& style);
+
+   const Gdiplus::Font* GetFont(unsigned char state) const;
+   const Gdiplus::Brush* GetBrush(unsigned char state) const;
+   const Gdiplus::Brush* GetBackBrush() const;
+
+private:
+   struct State
+   {
+      std::shared_ptr<const Gdiplus::Font> m_font;
+      std::shared_ptr<const Gdiplus::SolidBrush> m_brush;
+   };
+
+   State m_states[TextStateCount];
+   std::shared_ptr<const Gdiplus::SolidBrush> m_back_brush;
+};
+
+struct TextMetrics;
+
+// Text keeps only its string, boundary and state, everything else comes from the shared style.
+class Text : public Object
 {
 public:
    Text(const Gdiplus::Color& back_color, const wchar_t* font_name, 
@@ -57,25 +170,58 @@ public:
    
    bool SetText(const char* text);
    bool SetColor(const Gdiplus::Color& color);
+   // Old metrics are kept till the next layout, so wrapped text is reflowed from its cached advances.
+   bool SetWidth(unsigned long width);
+   const std::wstring& GetText() const;
+
+   // Draws the string in the state at the boundary, without background and caching.
+   // Display lists draw texts this way, sharing the style table between them.
+   void DrawString(Gdiplus::Graphics* graphics, const TextStyleTable& style_table, unsigned char state) const;
    
-   // ObjectWithBackground overrides
+   // Object overrides
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
 
 protected:
-   // Own virtual methods
-   virtual const wchar_t* GetFontName() const;
-   virtual unsigned long GetFontSize() const;
-   virtual unsigned long GetFontStyle() const;
-   virtual const Gdiplus::Color& GetFontColor() const;
-   
+   Text(const TextStyleParams& params, unsigned char state);
+
+   bool HasState(unsigned char state) const;
+   bool SetState(unsigned char state, bool is_set);
+   // Renders the text with the state flag toggled into the cache, so switching to it is a blit.
+   void PrerenderToggledState(Gdiplus::Graphics* graphics, unsigned char state) const;
+
+private:
+   void InvalidateCache();
+   Gdiplus::Bitmap* GetRenderedText(Gdiplus::Graphics* graphics, unsigned char state,
+                                    Gdiplus::REAL offset_x, Gdiplus::REAL offset_y) const;
+
 private:
+   // Rasterized text together with the visual state it was rendered for.
+   struct CacheEntry
+   {
+      unsigned char m_state;
+      Gdiplus::TextRenderingHint m_rendering_hint;
+      Gdiplus::REAL m_offset_x;
+      Gdiplus::REAL m_offset_y;
+      std::unique_ptr<Gdiplus::Bitmap> m_bitmap;
+   };
+
    std::wstring m_text;
-   const wchar_t* m_font_name;
-   unsigned long m_font_size;
-   unsigned long m_font_style;
-   Gdiplus::Color m_font_color;
-   unsigned long m_width;
+   std::shared_ptr<const TextMetrics> m_metrics;
+   mutable std::vector<CacheEntry> m_cache;
+   TextStyleIndex m_style_index;
+   unsigned char m_state;
+};
+
+// Text, wrapped at its width by own line breaking. Breaks are computed once per text
+// and width from cached word advances, so relayout and drawing don't measure it again.
+class WrappedText : public Text
+{
+public:
+   WrappedText(const Gdiplus::Color& back_color, const wchar_t* font_name,
+               unsigned long font_size, unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width);
 };
 
 class HoverableText : public Text
@@ -85,14 +231,15 @@ public:
                  unsigned long font_size, unsigned long font_style, const Gdiplus::Color& font_color, unsigned long width);
 
    // Text overrides
+   // Hovered variant is rendered together with the current one, so hover feedback is a blit.
+   virtual void Draw(Gdiplus::Graphics* graphics) const override;
    virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects) override;
 
 protected:
-   virtual unsigned long GetFontStyle() const override;
-   virtual unsigned long GetFontStyleWithoutHover() const;
+   HoverableText(const TextStyleParams& params, unsigned char state);
 
-private:
-   bool m_is_hovered;
+   // Own virtual method. Returns false, if the text doesn't react to hovering now.
+   virtual bool IsHoverable() const;
 };
 
 class ClickableText : public HoverableText
@@ -106,14 +253,10 @@ public:
 
    // Text overrides
    virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes) override;
-   virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects) override;
 
 protected:
-   virtual const Gdiplus::Color& GetFontColor() const override;
-
-private:
-   Gdiplus::Color m_clickable_font_color;
-   bool m_is_clickable;
+   // HoverableText overrides
+   virtual bool IsHoverable() const override;
 };
 
 class CollapsibleText : public HoverableText
@@ -128,16 +271,6 @@ public:
    
    // Object overrides
    virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes) override;
-
-protected:
-   // Text overrides
-   virtual unsigned long GetFontStyleWithoutHover() const override;
-   virtual const Gdiplus::Color& GetFontColor() const override;
-   
-private:
-   unsigned long m_collapsed_font_style;
-   Gdiplus::Color m_collapsed_font_color;
-   bool m_is_collapsed;
 };
 
 class Line : public ObjectWithBackground
@@ -145,26 +278,63 @@ class Line : public ObjectWithBackground
 public:
    Line(const Gdiplus::Color& back_color, const Gdiplus::Color& color, unsigned long width);
 
+   bool SetWidth(unsigned long width);
+
    // ObjectWithBackground overrides
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
 
 private:
    Gdiplus::Color m_color;
    unsigned long m_width;
 };
 
+// Single bitmap holding equally sized images in a row. Images are drawn as its
+// sub-rectangles, so any amount of Image objects share the same bitmap.
+class ImageAtlas
+{
+   ImageAtlas(const ImageAtlas& rhs) = delete;
+
+public:
+   ImageAtlas(unsigned long image_width, unsigned long image_height, unsigned long image_count);
+
+   unsigned long GetImageWidth() const;
+   unsigned long GetImageHeight() const;
+   unsigned long GetImageCount() const;
+
+   // Returns graphics with origin in the left top corner of the image,
+   // clipped by the image rectangle. Used to fill the atlas once.
+   std::unique_ptr<Gdiplus::Graphics> GetImageGraphics(unsigned long index);
+
+   void Draw(Gdiplus::Graphics* graphics, unsigned long index, Gdiplus::REAL x, Gdiplus::REAL y) const;
+
+private:
+   unsigned long m_image_width;
+   unsigned long m_image_height;
+   unsigned long m_image_count;
+   std::unique_ptr<Gdiplus::Bitmap> m_bitmap;
+};
+
 class Image : public Object
 {
 public:
-   Image(/*int resourse_id*/);
+   static const long NoImage = -1;
+
+   Image(const std::shared_ptr<const ImageAtlas>& atlas);
+
+   bool SetIndex(long index);
 
    // Object overrides
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
 
 private:
-   //Gdiplus::Image m_image;
+   std::shared_ptr<const ImageAtlas> m_atlas;
+   long m_index;
 };
 
 class Group : public Object
@@ -187,13 +357,18 @@ public:
    virtual void OffsetBoundary(Gdiplus::REAL offset_x, Gdiplus::REAL offset_y) override;   
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
    virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes) override;
    virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects) override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
    
 protected:
    // Own virtual method
    virtual bool IsObjectVisible(unsigned long index) const;
 
+   // Adds the child vector and all children, including invisible ones.
+   void CollectChildrenMemoryUsage(MemoryUsage& usage) const;
+
 protected:
    GroupType m_type;
    Gdiplus::REAL m_indent_before_x;
@@ -209,4 +384,331 @@ protected:
    std::vector<ObjectInfo> m_object_infos;
 };
 
+// Group, which renders its content into own bitmap layer and just blits it
+// while drawing. The layer is re-rendered only after InvalidateLayer or resize.
+class LayeredGroup : public Group
+{
+public:
+   LayeredGroup(GroupType type, Gdiplus::REAL indent_before_x = 0, Gdiplus::REAL indent_before_y = 0);
+
+   void InvalidateLayer();
+   // Group, which is resized on every frame, would re-render its layer every time,
+   // so while caching is disabled it is drawn directly and the layer is released.
+   void SetLayerCaching(bool is_enabled);
+   // Vertical offset of drawing from the boundary, e.g. while the group slides to its new place.
+   // Layer is blitted at the offset, so moving doesn't re-render it.
+   void SetDrawOffset(Gdiplus::REAL offset_y);
+   Gdiplus::REAL GetDrawOffset() const;
+
+   // Group overrides
+   virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
+   virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
+   virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes) override;
+   virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects) override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
+
+protected:
+   // Own virtual methods
+   virtual void DrawLayer(Gdiplus::Graphics* graphics) const;
+   virtual void RecordLayer(DisplayList& list) const;
+   // Returns false, while the owner draws the children without the layer, e.g. the
+   // collapsed sticker draws the title alone at its own place.
+   virtual bool IsLayerShown() const;
+
+private:
+   // Layer starts at the whole pixel under the boundary. Content keeps its fractional
+   // position inside it, so the cached layer looks like the group drawn directly.
+   Gdiplus::PointF GetLayerOrigin() const;
+
+private:
+   mutable std::unique_ptr<Gdiplus::Bitmap> m_layer;
+   mutable Gdiplus::TextRenderingHint m_layer_rendering_hint;
+   // Fractional part of the boundary position, which the layer is rendered for.
+   mutable Gdiplus::PointF m_layer_phase;
+   mutable bool m_is_layer_valid;
+   bool m_is_layer_caching;
+   Gdiplus::REAL m_draw_offset_y;
+};
+
+// Describes a child of FixedGroup: its type, aligning and indent after it.
+template <typename TObject, Group::AligningType aligning, unsigned long indent_after = 0>
+struct FixedChild
+{
+   using ObjectType = TObject;
+   static constexpr Group::AligningType Aligning = aligning;
+   static constexpr unsigned long IndentAfter = indent_after;
+};
+
+// Group with the shape known at compile time. Children are held by value and
+// accessed through non-virtual calls, so layout, drawing and hit tests get inlined.
+// Visibility of children can be customized by defining IsObjectVisible in TDerived
+// (it must grant access to the base using "friend Base;").
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+class FixedGroup : public Object
+{
+public:
+   FixedGroup(Gdiplus::REAL indent_before_x = 0, Gdiplus::REAL indent_before_y = 0);
+
+   // Object overrides
+   virtual void OffsetBoundary(Gdiplus::REAL offset_x, Gdiplus::REAL offset_y) override;
+   virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
+   virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(DisplayList& list) const override;
+   virtual ClickType ProcessClick(long x, long y, TULongVector& group_indexes) override;
+   virtual void ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects) override;
+   virtual void CollectMemoryUsage(MemoryUsage& usage) const override;
+
+protected:
+   using Base = FixedGroup;
+   using TObjects = std::tuple<typename TChildren::ObjectType...>;
+   static constexpr unsigned long ObjectCount = sizeof...(TChildren);
+
+   template <unsigned long index>
+   const std::tuple_element_t<index, TObjects>& GetObject() const;
+   template <unsigned long index>
+   std::tuple_element_t<index, TObjects>& GetObject();
+
+   bool IsObjectVisible(unsigned long index) const;
+
+private:
+   template <typename TFunc, std::size_t... indexes>
+   void ForEachVisibleObject(TFunc&& func, std::index_sequence<indexes...>);
+   template <typename TFunc, std::size_t... indexes>
+   void ForEachVisibleObject(TFunc&& func, std::index_sequence<indexes...>) const;
+   template <std::size_t... indexes>
+   void CollectChildrenMemoryUsage(MemoryUsage& usage, std::index_sequence<indexes...>) const;
+
+private:
+   Gdiplus::REAL m_indent_before_x;
+   Gdiplus::REAL m_indent_before_y;
+   TObjects m_objects;
+};
+
+///////////// class FixedGroup ////////////////
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+FixedGroup<TDerived, type, TChildren...>::FixedGroup(Gdiplus::REAL indent_before_x, Gdiplus::REAL indent_before_y) :
+   Object(), m_indent_before_x(indent_before_x), m_indent_before_y(indent_before_y), m_objects()
+{
+   // no code
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::OffsetBoundary(Gdiplus::REAL offset_x, Gdiplus::REAL offset_y)
+{
+   Object::OffsetBoundary(offset_x, offset_y);
+   ForEachVisibleObject([&](auto& object, auto, unsigned long)
+   {
+      using TObject = std::decay_t<decltype(object)>;
+      object.TObject::OffsetBoundary(offset_x, offset_y);
+   },
+   std::index_sequence_for<TChildren...>());
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::RecalculateBoundary(
+   Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
+{
+   m_boundary.X = x;
+   m_boundary.Y = y;
+   m_boundary.Width = 0;
+   m_boundary.Height = 0;
+
+   Gdiplus::REAL start_x = x + m_indent_before_x;
+   Gdiplus::REAL start_y = y + m_indent_before_y;
+
+   // The same two phases as in Group::RecalculateBoundary.
+
+   ForEachVisibleObject([&](auto& object, auto child, unsigned long)
+   {
+      using TObject = std::decay_t<decltype(object)>;
+      object.TObject::RecalculateBoundary(start_x, start_y, graphics);
+
+      const auto& object_boundary = object.GetBoundary();
+      if (Group::GroupType::Horizontal == type)
+      {
+         start_x = object_boundary.GetRight() + decltype(child)::IndentAfter;
+         start_y = object_boundary.GetTop();
+      }
+      else
+      {
+         start_x = object_boundary.GetLeft();
+         start_y = object_boundary.GetBottom() + decltype(child)::IndentAfter;
+      }
+
+      Gdiplus::RectF::Union(m_boundary, m_boundary, object_boundary);
+   },
+   std::index_sequence_for<TChildren...>());
+
+   ForEachVisibleObject([&](auto& object, auto child, unsigned long)
+   {
+      const auto aligning = decltype(child)::Aligning;
+      if (aligning != Group::AligningType::Min)
+      {
+         const auto& object_boundary = object.GetBoundary();
+
+         Gdiplus::REAL offset_x = 0;
+         Gdiplus::REAL offset_y = 0;
+
+         if (Group::GroupType::Horizontal == type && m_boundary.Height > object_boundary.Height)
+         {
+            offset_y = m_boundary.Height - object_boundary.Height - m_indent_before_y;
+            if (Group::AligningType::Middle == aligning)
+            {
+               offset_y /= 2;
+            }
+         }
+         else if (Group::GroupType::Vertical == type && m_boundary.Width > object_boundary.Width)
+         {
+            offset_x = m_boundary.Width - object_boundary.Width - m_indent_before_x;
+            if (Group::AligningType::Middle == aligning)
+            {
+               offset_x /= 2;
+            }
+         }
+
+         using TObject = std::decay_t<decltype(object)>;
+         object.TObject::OffsetBoundary(offset_x, offset_y);
+      }
+   },
+   std::index_sequence_for<TChildren...>());
+
+   // Take into account the last indent
+   const auto last_indent = std::tuple_element_t<ObjectCount - 1, std::tuple<TChildren...>>::IndentAfter;
+   if (Group::GroupType::Horizontal == type)
+   {
+      m_boundary.Width += last_indent;
+   }
+   else
+   {
+      m_boundary.Height += last_indent;
+   }
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::Draw(Gdiplus::Graphics* graphics) const
+{
+   ForEachVisibleObject([&](const auto& object, auto, unsigned long)
+   {
+      using TObject = std::decay_t<decltype(object)>;
+      object.TObject::Draw(graphics);
+   },
+   std::index_sequence_for<TChildren...>());
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::Record(DisplayList& list) const
+{
+   // Children are laid out one after another and never overlap, so they are recorded as
+   // a batch. A row of texts is replayed with one fill of the backgrounds then.
+   BeginRecordBatch(list);
+   ForEachVisibleObject([&](const auto& object, auto, unsigned long)
+   {
+      RecordChild(list, object);
+   },
+   std::index_sequence_for<TChildren...>());
+   EndRecordBatch(list);
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+Object::ClickType FixedGroup<TDerived, type, TChildren...>::ProcessClick(
+   long x, long y, TULongVector& group_indexes)
+{
+   auto click = ClickType::NoClick;
+   ForEachVisibleObject([&](auto& object, auto, unsigned long index)
+   {
+      if (ClickType::NoClick == click)
+      {
+         using TObject = std::decay_t<decltype(object)>;
+         click = object.TObject::ProcessClick(x, y, group_indexes);
+         if (click != ClickType::NoClick)
+         {
+            group_indexes.push_front(index);
+         }
+      }
+   },
+   std::index_sequence_for<TChildren...>());
+   return click;
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::ProcessHover(long x, long y, TObjectPtrVector& invalidated_objects)
+{
+   ForEachVisibleObject([&](auto& object, auto, unsigned long)
+   {
+      using TObject = std::decay_t<decltype(object)>;
+      object.TObject::ProcessHover(x, y, invalidated_objects);
+   },
+   std::index_sequence_for<TChildren...>());
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+void FixedGroup<TDerived, type, TChildren...>::CollectMemoryUsage(MemoryUsage& usage) const
+{
+   // Children are held by value, they are accounted as own nodes.
+   usage.AddNode(typeid(*this), sizeof(TDerived) - sizeof(TObjects));
+   CollectChildrenMemoryUsage(usage, std::index_sequence_for<TChildren...>());
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+template <unsigned long index>
+const std::tuple_element_t<index, typename FixedGroup<TDerived, type, TChildren...>::TObjects>&
+FixedGroup<TDerived, type, TChildren...>::GetObject() const
+{
+   return std::get<index>(m_objects);
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+template <unsigned long index>
+std::tuple_element_t<index, typename FixedGroup<TDerived, type, TChildren...>::TObjects>&
+FixedGroup<TDerived, type, TChildren...>::GetObject()
+{
+   return std::get<index>(m_objects);
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+bool FixedGroup<TDerived, type, TChildren...>::IsObjectVisible(unsigned long index) const
+{
+   return true;
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+template <typename TFunc, std::size_t... indexes>
+void FixedGroup<TDerived, type, TChildren...>::ForEachVisibleObject(
+   TFunc&& func, std::index_sequence<indexes...>)
+{
+   const auto& derived = static_cast<const TDerived&>(*this);
+   const bool expander[] =
+   {
+      true, (derived.IsObjectVisible(indexes) && (func(std::get<indexes>(m_objects), TChildren(), indexes), true))...
+   };
+   static_cast<void>(expander);
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+template <typename TFunc, std::size_t... indexes>
+void FixedGroup<TDerived, type, TChildren...>::ForEachVisibleObject(
+   TFunc&& func, std::index_sequence<indexes...>) const
+{
+   const auto& derived = static_cast<const TDerived&>(*this);
+   const bool expander[] =
+   {
+      true, (derived.IsObjectVisible(indexes) && (func(std::get<indexes>(m_objects), TChildren(), indexes), true))...
+   };
+   static_cast<void>(expander);
+}
+
+template <typename TDerived, Group::GroupType type, typename... TChildren>
+template <std::size_t... indexes>
+void FixedGroup<TDerived, type, TChildren...>::CollectChildrenMemoryUsage(
+   MemoryUsage& usage, std::index_sequence<indexes...>) const
+{
+   const bool expander[] =
+   {
+      true, (std::get<indexes>(m_objects).CollectMemoryUsage(usage), true)...
+   };
+   static_cast<void>(expander);
+}
+
 } // namespace BGO
@@ -0,0 +1,279 @@
+#include "input_replay.h"
+
+#include <istream>
+#include <ostream>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+
+//////////// Constants /////////////
+
+const char g_recording_signature[] = "sticker-input";
+const auto g_recording_version = 2;
+
+const char* const g_event_type_names[] = { "move", "hover", "leave", "click" };
+
+const double g_reported_percentiles[] = { 50.0, 90.0, 99.0 };
+
+} // namespace
+
+/////////////// struct InputStartState /////////////////
+
+InputStartState::InputStartState() :
+   m_is_collapsed(true), m_width(0), m_section_count(0), m_shown_section_count(0), m_expanded_sections()
+{
+   // no code
+}
+
+InputStartState InputStartState::Get(const StickerModel& sticker)
+{
+   InputStartState state;
+   state.m_is_collapsed = sticker.GetCollapsed();
+   state.m_width = sticker.GetWidth();
+   state.m_section_count = sticker.GetSectionCount();
+   state.m_shown_section_count = sticker.GetShownSectionCount();
+   for (auto index = 0UL; index < state.m_section_count; ++index)
+   {
+      if (sticker.IsSectionExpanded(index))
+      {
+         state.m_expanded_sections.push_back(index);
+      }
+   }
+   return state;
+}
+
+bool InputStartState::operator==(const InputStartState& rhs) const
+{
+   return m_is_collapsed == rhs.m_is_collapsed && m_width == rhs.m_width &&
+          m_section_count == rhs.m_section_count && m_shown_section_count == rhs.m_shown_section_count &&
+          m_expanded_sections == rhs.m_expanded_sections;
+}
+
+/////////////// class InputRecording /////////////////
+
+InputRecording::InputRecording() :
+   m_width(0), m_height(0), m_start_state(), m_events(), m_timer()
+{
+   // no code
+}
+
+void InputRecording::Start(long width, long height, const InputStartState& state)
+{
+   m_width = width;
+   m_height = height;
+   m_start_state = state;
+   m_events.clear();
+   m_timer.Restart();
+}
+
+void InputRecording::Add(InputEvent::Type type, long x, long y, bool is_collapsed)
+{
+   m_events.push_back(InputEvent{ type, x, y, m_timer.GetElapsed(), is_collapsed });
+}
+
+long InputRecording::GetWidth() const
+{
+   return m_width;
+}
+
+long InputRecording::GetHeight() const
+{
+   return m_height;
+}
+
+bool InputRecording::GetCollapsed() const
+{
+   return m_start_state.m_is_collapsed;
+}
+
+const InputStartState& InputRecording::GetStartState() const
+{
+   return m_start_state;
+}
+
+const std::vector<InputEvent>& InputRecording::GetEvents() const
+{
+   return m_events;
+}
+
+void InputRecording::Save(std::ostream& stream) const
+{
+   stream << g_recording_signature << ' ' << g_recording_version << ' '
+          << m_width << ' ' << m_height << ' ' << m_start_state.m_is_collapsed << ' '
+          << m_start_state.m_width << ' ' << m_start_state.m_section_count << ' '
+          << m_start_state.m_shown_section_count << ' ' << m_start_state.m_expanded_sections.size();
+   for (const auto index : m_start_state.m_expanded_sections)
+   {
+      stream << ' ' << index;
+   }
+   stream << ' ' << m_events.size() << '\n';
+
+   for (const auto& event : m_events)
+   {
+      stream << static_cast<int>(event.m_type) << ' ' << event.m_x << ' ' << event.m_y << ' '
+             << event.m_time << ' ' << event.m_is_collapsed << '\n';
+   }
+}
+
+bool InputRecording::Load(std::istream& stream)
+{
+   std::string signature;
+   auto version = 0;
+   size_t expanded_count = 0;
+   InputRecording recording;
+   auto& state = recording.m_start_state;
+   stream >> signature >> version >> recording.m_width >> recording.m_height >> state.m_is_collapsed >>
+             state.m_width >> state.m_section_count >> state.m_shown_section_count >> expanded_count;
+   if (!stream || signature != g_recording_signature || version != g_recording_version ||
+       expanded_count > state.m_section_count)
+   {
+      return false;
+   }
+
+   state.m_expanded_sections.resize(expanded_count);
+   for (auto& index : state.m_expanded_sections)
+   {
+      stream >> index;
+   }
+   size_t count = 0;
+   stream >> count;
+   if (!stream)
+   {
+      return false;
+   }
+
+   recording.m_events.reserve(count);
+   for (auto index = 0UL; index < count; ++index)
+   {
+      auto type = 0;
+      InputEvent event;
+      stream >> type >> event.m_x >> event.m_y >> event.m_time >> event.m_is_collapsed;
+      if (!stream || type < 0 || type >= static_cast<int>(InputEvent::Type::Count))
+      {
+         return false;
+      }
+      event.m_type = static_cast<InputEvent::Type>(type);
+      recording.m_events.push_back(event);
+   }
+
+   m_width = recording.m_width;
+   m_height = recording.m_height;
+   m_start_state = recording.m_start_state;
+   m_events.swap(recording.m_events);
+   return true;
+}
+
+/////////////// struct InputReplayReport /////////////////
+
+const LatencyStatistics& InputReplayReport::GetLatencies(InputEvent::Type type) const
+{
+   return m_latencies[static_cast<size_t>(type)];
+}
+
+void InputReplayReport::Print(std::ostream& stream) const
+{
+   // Format of the caller's stream is restored afterwards.
+   std::ios format(nullptr);
+   format.copyfmt(stream);
+
+   if (!m_is_start_matched)
+   {
+      stream << "start state differs from the recording, nothing is replayed\n";
+      return;
+   }
+
+   stream << std::fixed << std::setprecision(3);
+   for (auto index = 0UL; index < static_cast<unsigned long>(InputEvent::Type::Count); ++index)
+   {
+      const auto& latencies = m_latencies[index];
+      if (0 == latencies.GetCount())
+      {
+         continue;
+      }
+
+      stream << g_event_type_names[index] << ": count " << latencies.GetCount();
+      for (const auto percentile : g_reported_percentiles)
+      {
+         stream << ", p" << static_cast<unsigned long>(percentile) << ' ' << latencies.GetPercentile(percentile) << " ms";
+      }
+      stream << ", max " << latencies.GetMax() << " ms\n";
+   }
+   stream << "diverged events: " << m_diverged_count << '\n';
+
+   stream.copyfmt(format);
+}
+
+/////////////// class InputReplayer /////////////////
+
+InputReplayer::InputReplayer(const InputRecording& recording, TFiller filler) :
+   m_recording(recording), m_filler(std::move(filler))
+{
+   // no code
+}
+
+InputReplayReport InputReplayer::Run(unsigned long repeat_count) const
+{
+   InputReplayReport report;
+   report.m_is_start_matched = true;
+   report.m_diverged_count = 0;
+
+   const auto& start_state = m_recording.GetStartState();
+   for (auto repeat = 0UL; repeat < repeat_count; ++repeat)
+   {
+      HeadlessSticker sticker(m_recording.GetWidth(), m_recording.GetHeight());
+      if (m_filler)
+      {
+         m_filler(sticker);
+      }
+      sticker.SetWidth(start_state.m_width);
+      sticker.SetCollapsed(start_state.m_is_collapsed);
+      if (!(InputStartState::Get(sticker) == start_state))
+      {
+         report.m_is_start_matched = false;
+         return report;
+      }
+      sticker.Render();
+
+      for (const auto& event : m_recording.GetEvents())
+      {
+         LatencyTimer timer;
+         switch (event.m_type)
+         {
+            case InputEvent::Type::MouseMove:
+            {
+               // Sticker only starts mouse tracking on move, there is nothing to replay.
+               continue;
+            }
+            case InputEvent::Type::MouseHover:
+            {
+               sticker.Hover(event.m_x, event.m_y);
+               break;
+            }
+            case InputEvent::Type::MouseLeave:
+            {
+               sticker.Hover(-1, -1);
+               break;
+            }
+            case InputEvent::Type::LButtonUp:
+            {
+               sticker.Click(event.m_x, event.m_y);
+               break;
+            }
+            case InputEvent::Type::Count:
+            {
+               continue;
+            }
+         }
+         report.m_latencies[static_cast<size_t>(event.m_type)].Add(timer.GetElapsed());
+
+         if (sticker.GetCollapsed() != event.m_is_collapsed)
+         {
+            ++report.m_diverged_count;
+         }
+      }
+   }
+
+   return report;
+}
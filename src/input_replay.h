@@ -0,0 +1,98 @@
+#pragma once
+
+#include "sticker.h"
+#include "latency_statistics.h"
+
+#include <vector>
+#include <iosfwd>
+#include <functional>
+
+// Mouse message, as it came to the window of a sticker.
+struct InputEvent
+{
+   enum class Type { MouseMove, MouseHover, MouseLeave, LButtonUp, Count };
+
+   Type m_type;
+   long m_x;
+   long m_y;
+   double m_time;        // Milliseconds since start of the recording
+   bool m_is_collapsed;  // State of the sticker after the event
+};
+
+// State of a sticker, which decides what the recorded input hits. Hovering isn't kept,
+// the first recorded hover or leave sets it anyway.
+struct InputStartState
+{
+   InputStartState();
+
+   static InputStartState Get(const StickerModel& sticker);
+   bool operator==(const InputStartState& rhs) const;
+
+   bool m_is_collapsed;
+   unsigned long m_width;                            // Width of the expanded sticker
+   unsigned long m_section_count;
+   unsigned long m_shown_section_count;
+   std::vector<unsigned long> m_expanded_sections;   // Indexes, ascending
+};
+
+// Stream of mouse messages of one sticker, together with the sticker
+// state at the start. It can be saved to and loaded from a text stream.
+class InputRecording
+{
+public:
+   InputRecording();
+
+   // Width and height define the size of the collapsed sticker.
+   void Start(long width, long height, const InputStartState& state);
+   void Add(InputEvent::Type type, long x, long y, bool is_collapsed);
+
+   long GetWidth() const;
+   long GetHeight() const;
+   bool GetCollapsed() const;
+   const InputStartState& GetStartState() const;
+   const std::vector<InputEvent>& GetEvents() const;
+
+   void Save(std::ostream& stream) const;
+   // Returns false, if the stream doesn't contain a valid recording.
+   bool Load(std::istream& stream);
+
+private:
+   long m_width;
+   long m_height;
+   InputStartState m_start_state;
+   std::vector<InputEvent> m_events;
+   LatencyTimer m_timer;
+};
+
+// Latencies of replayed events, per event type.
+struct InputReplayReport
+{
+   LatencyStatistics m_latencies[static_cast<size_t>(InputEvent::Type::Count)];
+   // Filled sticker starts in the recorded state. Otherwise the input would hit other
+   // objects, so nothing is replayed.
+   bool m_is_start_matched;
+   // Events, after which the sticker state differs from the recorded one.
+   unsigned long m_diverged_count;
+
+   const LatencyStatistics& GetLatencies(InputEvent::Type type) const;
+   void Print(std::ostream& stream) const;
+};
+
+// Feeds a recording straight into the sticker objects of a headless sticker,
+// without a window and a message loop, and measures each event.
+class InputReplayer
+{
+public:
+   // Fills content of the sticker before the replay. Collapsed state and width are
+   // restored from the recording after it, the rest of the start state is verified.
+   using TFiller = std::function<void(StickerModel& sticker)>;
+
+   InputReplayer(const InputRecording& recording, TFiller filler);
+
+   // Replays the recording repeat_count times, each time on a fresh sticker.
+   InputReplayReport Run(unsigned long repeat_count = 1) const;
+
+private:
+   const InputRecording& m_recording;
+   TFiller m_filler;
+};
@@ -0,0 +1,323 @@
+#include "latency_statistics.h"
+
+#include <ostream>
+#include <iomanip>
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+
+namespace
+{
+
+//////////// Constants /////////////
+
+const auto g_first_bucket_bound = 0.5;   // Milliseconds
+
+const char* GetStageName(ClickStage stage)
+{
+   switch (stage)
+   {
+      case ClickStage::Click:
+         return "click";
+      case ClickStage::Layout:
+         return "layout";
+      case ClickStage::Resize:
+         return "resize";
+      case ClickStage::Queue:
+         return "queue";
+      case ClickStage::Render:
+         return "render";
+      case ClickStage::Blit:
+         return "blit";
+      case ClickStage::Last:
+         break;
+   }
+   return "";
+}
+
+void PrintStatistics(std::ostream& stream, const char* name, const LatencyHistogram& statistics)
+{
+   stream << name << ": p50 " << statistics.GetPercentile(50.0)
+          << " ms, p99 " << statistics.GetPercentile(99.0)
+          << " ms, max " << statistics.GetMax() << " ms\n";
+}
+
+} // namespace
+
+/////////////// class LatencyTimer /////////////////
+
+LatencyTimer::LatencyTimer() : m_start(std::chrono::steady_clock::now())
+{
+   // no code
+}
+
+void LatencyTimer::Restart()
+{
+   m_start = std::chrono::steady_clock::now();
+}
+
+double LatencyTimer::GetElapsed() const
+{
+   const auto elapsed = std::chrono::steady_clock::now() - m_start;
+   return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+/////////////// class LatencyStatistics /////////////////
+
+LatencyStatistics::LatencyStatistics() : m_samples(), m_is_sorted(true), m_sum(0.0)
+{
+   // no code
+}
+
+void LatencyStatistics::Add(double milliseconds)
+{
+   m_samples.push_back(milliseconds);
+   m_is_sorted = false;
+   m_sum += milliseconds;
+}
+
+void LatencyStatistics::Clear()
+{
+   m_samples.clear();
+   m_is_sorted = true;
+   m_sum = 0.0;
+}
+
+unsigned long LatencyStatistics::GetCount() const
+{
+   return static_cast<unsigned long>(m_samples.size());
+}
+
+double LatencyStatistics::GetMean() const
+{
+   return m_samples.empty() ? 0.0 : m_sum / m_samples.size();
+}
+
+double LatencyStatistics::GetMax() const
+{
+   return GetPercentile(100.0);
+}
+
+double LatencyStatistics::GetPercentile(double percentile) const
+{
+   if (m_samples.empty())
+   {
+      return 0.0;
+   }
+
+   if (!m_is_sorted)
+   {
+      std::sort(m_samples.begin(), m_samples.end());
+      m_is_sorted = true;
+   }
+
+   const auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * m_samples.size()));
+   return m_samples[(std::min)((std::max)(rank, static_cast<size_t>(1)), m_samples.size()) - 1];
+}
+
+std::vector<unsigned long> LatencyStatistics::GetHistogram(const std::vector<double>& bounds) const
+{
+   if (!m_is_sorted)
+   {
+      std::sort(m_samples.begin(), m_samples.end());
+      m_is_sorted = true;
+   }
+
+   std::vector<unsigned long> counts;
+   counts.reserve(bounds.size() + 1);
+   auto begin = m_samples.cbegin();
+   for (const auto bound : bounds)
+   {
+      const auto end = std::upper_bound(begin, m_samples.cend(), bound);
+      counts.push_back(static_cast<unsigned long>(end - begin));
+      begin = end;
+   }
+   counts.push_back(static_cast<unsigned long>(m_samples.cend() - begin));
+   return counts;
+}
+
+/////////////// class LatencyHistogram /////////////////
+
+LatencyHistogram::LatencyHistogram() : m_counts(), m_count(0), m_sum(0.0), m_max(0.0)
+{
+   // no code
+}
+
+void LatencyHistogram::Add(double milliseconds)
+{
+   auto index = 0UL;
+   if (milliseconds > g_first_bucket_bound)
+   {
+      const auto bucket = std::ceil(2.0 * std::log2(milliseconds / g_first_bucket_bound));
+      index = static_cast<unsigned long>((std::min)(bucket, static_cast<double>(BucketCount - 1)));
+   }
+
+   ++m_counts[index];
+   ++m_count;
+   m_sum += milliseconds;
+   m_max = (std::max)(m_max, milliseconds);
+}
+
+void LatencyHistogram::Clear()
+{
+   std::fill(std::begin(m_counts), std::end(m_counts), 0);
+   m_count = 0;
+   m_sum = 0.0;
+   m_max = 0.0;
+}
+
+unsigned long LatencyHistogram::GetCount() const
+{
+   return m_count;
+}
+
+double LatencyHistogram::GetMean() const
+{
+   return (0 == m_count) ? 0.0 : m_sum / m_count;
+}
+
+double LatencyHistogram::GetMax() const
+{
+   return m_max;
+}
+
+double LatencyHistogram::GetPercentile(double percentile) const
+{
+   if (0 == m_count)
+   {
+      return 0.0;
+   }
+
+   const auto rank = (std::max)(static_cast<unsigned long>(std::ceil(percentile / 100.0 * m_count)), 1UL);
+   auto count = 0UL;
+   for (auto index = 0UL; index < BucketCount; ++index)
+   {
+      count += m_counts[index];
+      if (count >= rank)
+      {
+         return (std::min)(GetBucketBound(index), m_max);
+      }
+   }
+   return m_max;
+}
+
+double LatencyHistogram::GetBucketBound(unsigned long index)
+{
+   if (index + 1 >= BucketCount)
+   {
+      return std::numeric_limits<double>::infinity();
+   }
+   return g_first_bucket_bound * std::pow(2.0, index / 2.0);
+}
+
+unsigned long LatencyHistogram::GetBucketCount(unsigned long index) const
+{
+   return m_counts[index];
+}
+
+/////////////// class ClickLatency /////////////////
+
+ClickLatency::ClickLatency() :
+   m_timer(), m_last_mark(0.0), m_is_active(false), m_budget(0.0), m_over_budget_count(0), m_stages(), m_total()
+{
+   // no code
+}
+
+void ClickLatency::SetBudget(double budget)
+{
+   m_budget = budget;
+}
+
+double ClickLatency::GetBudget() const
+{
+   return m_budget;
+}
+
+void ClickLatency::Begin()
+{
+   m_timer.Restart();
+   m_last_mark = 0.0;
+   m_is_active = true;
+}
+
+void ClickLatency::Mark(ClickStage stage)
+{
+   if (m_is_active)
+   {
+      const auto now = m_timer.GetElapsed();
+      m_stages[static_cast<size_t>(stage)].Add(now - m_last_mark);
+      m_last_mark = now;
+   }
+}
+
+bool ClickLatency::End()
+{
+   if (!m_is_active)
+   {
+      return true;
+   }
+
+   const auto total = m_timer.GetElapsed();
+   m_total.Add(total);
+   m_is_active = false;
+
+   if (m_budget > 0.0 && total > m_budget)
+   {
+      ++m_over_budget_count;
+      return false;
+   }
+   return true;
+}
+
+void ClickLatency::Cancel()
+{
+   m_is_active = false;
+}
+
+bool ClickLatency::IsActive() const
+{
+   return m_is_active;
+}
+
+const LatencyHistogram& ClickLatency::GetStage(ClickStage stage) const
+{
+   return m_stages[static_cast<size_t>(stage)];
+}
+
+const LatencyHistogram& ClickLatency::GetTotal() const
+{
+   return m_total;
+}
+
+unsigned long ClickLatency::GetOverBudgetCount() const
+{
+   return m_over_budget_count;
+}
+
+void ClickLatency::Clear()
+{
+   for (auto& stage : m_stages)
+   {
+      stage.Clear();
+   }
+   m_total.Clear();
+   m_over_budget_count = 0;
+}
+
+void ClickLatency::Print(std::ostream& stream) const
+{
+   // Format of the caller's stream is restored afterwards.
+   std::ios format(nullptr);
+   format.copyfmt(stream);
+
+   stream << std::fixed << std::setprecision(3);
+   for (auto index = 0UL; index < static_cast<unsigned long>(ClickStage::Last); ++index)
+   {
+      PrintStatistics(stream, GetStageName(static_cast<ClickStage>(index)), m_stages[index]);
+   }
+   PrintStatistics(stream, "total", m_total);
+   stream << "clicks: " << m_total.GetCount() << ", over budget: " << m_over_budget_count << '\n';
+
+   stream.copyfmt(format);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <iosfwd>
+
+// Measures time from its construction or the last restart.
+class LatencyTimer
+{
+public:
+   LatencyTimer();
+
+   void Restart();
+   // Milliseconds since construction or the last restart.
+   double GetElapsed() const;
+
+private:
+   std::chrono::steady_clock::time_point m_start;
+};
+
+// Collects durations of a repeated operation and reports their distribution.
+class LatencyStatistics
+{
+public:
+   LatencyStatistics();
+
+   void Add(double milliseconds);
+   void Clear();
+
+   unsigned long GetCount() const;
+   double GetMean() const;
+   double GetMax() const;
+   // Nearest-rank percentile, percentile is in [0, 100]. Zero for no samples.
+   double GetPercentile(double percentile) const;
+   // Counts of samples up to each of the ascending bounds, the last count is of the ones above.
+   std::vector<unsigned long> GetHistogram(const std::vector<double>& bounds) const;
+
+private:
+   // Sorted lazily, on the first request of a percentile after additions.
+   mutable std::vector<double> m_samples;
+   mutable bool m_is_sorted;
+   double m_sum;
+};
+
+// Distribution of durations in fixed buckets, which grow by the square root of two from half
+// a millisecond. Its size doesn't depend on the amount of samples, so it suits always-on
+// tracking. Percentiles are precise to the bucket.
+class LatencyHistogram
+{
+public:
+   static const unsigned long BucketCount = 25;   // The last one holds everything above
+
+   LatencyHistogram();
+
+   void Add(double milliseconds);
+   void Clear();
+
+   unsigned long GetCount() const;
+   double GetMean() const;
+   double GetMax() const;
+   // Upper bound of the bucket of the nearest-rank sample, but not above the maximum.
+   double GetPercentile(double percentile) const;
+
+   // Samples up to the upper bound of the bucket and above the bound of the previous one.
+   static double GetBucketBound(unsigned long index);
+   unsigned long GetBucketCount(unsigned long index) const;
+
+private:
+   unsigned long m_counts[BucketCount];
+   unsigned long m_count;
+   double m_sum;
+   double m_max;
+};
+
+// Stages of the way from a click to its pixels on the screen.
+enum class ClickStage
+{
+   Click,    // Hit test and the callbacks
+   Layout,   // Relayout of the sticker
+   Resize,   // The window follows its content
+   Queue,    // Waiting for WM_PAINT
+   Render,   // Drawing into the back buffer
+   Blit,     // Copying to the screen
+   Last
+};
+
+// End-to-end latency of clicks, which change the layout: time of each stage and the total
+// from the button release to the frame on the screen, checked against a latency budget.
+class ClickLatency
+{
+public:
+   ClickLatency();
+
+   // Budget of the total latency, milliseconds. Zero means no budget.
+   void SetBudget(double budget);
+   double GetBudget() const;
+
+   // Starts tracking of a click, the unfinished previous one is dropped.
+   void Begin();
+   // Ends the stage, which has started with the previous mark. Ignored, if no click is tracked.
+   void Mark(ClickStage stage);
+   // Adds the total, when the frame is shown. Returns false, if the budget is exceeded.
+   bool End();
+   // Drops the tracked click, e.g. it hasn't changed the layout.
+   void Cancel();
+   bool IsActive() const;
+
+   const LatencyHistogram& GetStage(ClickStage stage) const;
+   const LatencyHistogram& GetTotal() const;
+   unsigned long GetOverBudgetCount() const;
+   void Clear();
+
+   void Print(std::ostream& stream) const;
+
+private:
+   LatencyTimer m_timer;
+   double m_last_mark;
+   bool m_is_active;
+   double m_budget;
+   unsigned long m_over_budget_count;
+   LatencyHistogram m_stages[static_cast<size_t>(ClickStage::Last)];
+   LatencyHistogram m_total;
+};
@@ -0,0 +1,232 @@
+#include "load_generator.h"
+
+#include <ostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+
+//////////// Constants /////////////
+
+const ImageType g_images[] = { ImageType::None, ImageType::Ok, ImageType::Expired, ImageType::Minus, ImageType::Arrow };
+const ColorType g_colors[] = { ColorType::Green, ColorType::Red, ColorType::Grey };
+const auto g_image_count = static_cast<unsigned long>(sizeof(g_images) / sizeof(g_images[0]));
+const auto g_color_count = static_cast<unsigned long>(sizeof(g_colors) / sizeof(g_colors[0]));
+
+} // namespace
+
+/////////////// struct LoadOptions /////////////////
+
+LoadOptions::LoadOptions() :
+   m_updates_per_second(100.0),
+   m_frames_per_second(60.0),
+   m_duration(10.0),
+   m_title_weight(4),
+   m_item_append_weight(2),
+   m_item_edit_weight(4),
+   m_section_count_weight(1),
+   m_resize_weight(0),
+   m_max_section_count(8),
+   m_max_item_count(20),
+   m_min_resize_width(200),
+   m_max_resize_width(500),
+   m_width(100),
+   m_height(22),
+   m_seed(1),
+   m_is_display_list(false)
+{
+   // no code
+}
+
+/////////////// struct LoadReport /////////////////
+
+double LoadReport::GetUpdatesPerSecond() const
+{
+   return (m_duration > 0.0) ? m_update_count / m_duration : 0.0;
+}
+
+void LoadReport::Print(std::ostream& stream) const
+{
+   // Format of the caller's stream is restored afterwards.
+   std::ios format(nullptr);
+   format.copyfmt(stream);
+
+   stream << std::fixed << std::setprecision(3)
+          << "updates: " << m_update_count << " (" << GetUpdatesPerSecond() << " per second)\n"
+          << "frames: " << m_frame_count << ", dropped: " << m_dropped_frame_count << '\n'
+          << "update to pixels: p50 " << m_update_to_pixels.GetPercentile(50.0)
+          << " ms, p99 " << m_update_to_pixels.GetPercentile(99.0)
+          << " ms, max " << m_update_to_pixels.GetMax() << " ms\n";
+
+   stream.copyfmt(format);
+}
+
+/////////////// class StickerLoadGenerator /////////////////
+
+StickerLoadGenerator::StickerLoadGenerator(const LoadOptions& options) :
+   m_options(options), m_random(options.m_seed), m_update_index(0), m_item_counts()
+{
+   // no code
+}
+
+LoadReport StickerLoadGenerator::Run()
+{
+   LoadReport report;
+   report.m_update_count = 0;
+   report.m_frame_count = 0;
+   report.m_dropped_frame_count = 0;
+
+   HeadlessSticker sticker(m_options.m_width, m_options.m_height);
+   sticker.SetDisplayListMode(m_options.m_is_display_list);
+   sticker.SetRedraw(false);
+   {
+      m_update_index = 0;
+      m_item_counts.assign(1, 0);
+      sticker.SetSectionCount(1);
+      FillSection(sticker.GetSection(0), 0);
+      sticker.SetCollapsed(false);
+      sticker.SetLiveResize(m_options.m_resize_weight > 0);
+   }
+   sticker.SetRedraw(true);
+   sticker.Render();
+
+   const auto update_interval = 1000.0 / m_options.m_updates_per_second;
+   const auto frame_interval = 1000.0 / m_options.m_frames_per_second;
+   const auto duration = 1000.0 * m_options.m_duration;
+
+   // Times of the updates, which are not rendered yet.
+   std::vector<double> pending_updates;
+   auto next_update = 0.0;
+   auto next_frame = frame_interval;
+
+   LatencyTimer clock;
+   for (auto now = clock.GetElapsed(); now < duration; now = clock.GetElapsed())
+   {
+      const auto next_event = (std::min)(next_update, next_frame);
+      if (next_event > now)
+      {
+         std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(next_event - now));
+         continue;
+      }
+
+      if (next_update < next_frame)
+      {
+         // Updates, which haven't changed the image (e.g. an edit of a hidden item),
+         // are never rendered and have no latency.
+         const auto update_time = clock.GetElapsed();
+         const auto invalidation_count = sticker.GetInvalidationCount();
+         ApplyUpdate(sticker);
+         if (sticker.GetInvalidationCount() != invalidation_count)
+         {
+            pending_updates.push_back(update_time);
+         }
+         ++report.m_update_count;
+         next_update += update_interval;
+         continue;
+      }
+
+      if (sticker.IsInvalidated())
+      {
+         sticker.Render();
+         ++report.m_frame_count;
+
+         const auto frame_time = clock.GetElapsed();
+         for (const auto update_time : pending_updates)
+         {
+            report.m_update_to_pixels.Add(frame_time - update_time);
+         }
+         pending_updates.clear();
+      }
+
+      // Frame slots, which have passed while being late, are lost.
+      next_frame += frame_interval;
+      for (const auto frame_time = clock.GetElapsed(); next_frame <= frame_time; next_frame += frame_interval)
+      {
+         ++report.m_dropped_frame_count;
+      }
+   }
+
+   report.m_duration = clock.GetElapsed() / 1000.0;
+   return report;
+}
+
+void StickerLoadGenerator::ApplyUpdate(StickerModel& sticker)
+{
+   ++m_update_index;
+
+   const auto total_weight = m_options.m_title_weight + m_options.m_item_append_weight +
+                             m_options.m_item_edit_weight + m_options.m_section_count_weight +
+                             m_options.m_resize_weight;
+   auto choice = GetRandom((std::max)(1UL, total_weight));
+
+   if (choice < m_options.m_resize_weight)
+   {
+      const auto min_width = (std::min)(m_options.m_min_resize_width, m_options.m_max_resize_width);
+      sticker.SetWidth(min_width + GetRandom(m_options.m_max_resize_width - min_width + 1));
+      return;
+   }
+   choice -= m_options.m_resize_weight;
+
+   const auto section_index = GetRandom(static_cast<unsigned long>(m_item_counts.size()));
+   auto& section = sticker.GetSection(section_index);
+   auto& item_count = m_item_counts[section_index];
+
+   std::stringstream sstream;
+   sstream << "Update " << m_update_index;
+   const auto text = sstream.str();
+
+   if (choice < m_options.m_title_weight)
+   {
+      section.SetTitle(g_images[GetRandom(g_image_count)], "21.09", "12:45", text.c_str(), g_colors[GetRandom(g_color_count)]);
+      return;
+   }
+   choice -= m_options.m_title_weight;
+
+   if (choice < m_options.m_item_append_weight && item_count < m_options.m_max_item_count)
+   {
+      section.SetItemCount(item_count + 1);
+      section.SetItem(item_count, g_images[GetRandom(g_image_count)], "21.09", "12:45", text.c_str(), 0 == GetRandom(2));
+      ++item_count;
+      return;
+   }
+   choice -= (std::min)(choice, m_options.m_item_append_weight);
+
+   if (choice < m_options.m_item_edit_weight || 0 == m_options.m_section_count_weight)
+   {
+      if (0 == item_count)
+      {
+         section.SetItemCount(1);
+         item_count = 1;
+      }
+      section.SetItem(GetRandom(item_count), g_images[GetRandom(g_image_count)], "21.09", "12:45", text.c_str(), 0 == GetRandom(2));
+      return;
+   }
+
+   const auto old_count = static_cast<unsigned long>(m_item_counts.size());
+   const auto new_count = 1 + GetRandom((std::max)(1UL, m_options.m_max_section_count));
+   sticker.SetSectionCount(new_count);
+   m_item_counts.resize(new_count, 0);
+   for (auto index = old_count; index < new_count; ++index)
+   {
+      FillSection(sticker.GetSection(index), index);
+   }
+}
+
+void StickerLoadGenerator::FillSection(ISection& section, unsigned long section_index)
+{
+   std::stringstream sstream;
+   sstream << "Section " << (section_index + 1);
+   section.SetTitle(ImageType::None, "21.09", "12:45", sstream.str().c_str(), ColorType::Green);
+   section.SetOwnerName("Load generator");
+   section.SetItemCount(0);
+   m_item_counts[section_index] = 0;
+}
+
+unsigned long StickerLoadGenerator::GetRandom(unsigned long limit)
+{
+   return (limit > 1) ? std::uniform_int_distribution<unsigned long>(0, limit - 1)(m_random) : 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "sticker.h"
+#include "latency_statistics.h"
+
+#include <iosfwd>
+#include <vector>
+#include <random>
+
+// Parameters of a synthetic feed of section updates.
+struct LoadOptions
+{
+   LoadOptions();
+
+   double m_updates_per_second;
+   double m_frames_per_second;   // Frame budget of the paint loop
+   double m_duration;            // Seconds
+
+   // Relative weights of the update kinds in the mix.
+   unsigned long m_title_weight;
+   unsigned long m_item_append_weight;
+   unsigned long m_item_edit_weight;
+   unsigned long m_section_count_weight;
+   unsigned long m_resize_weight;   // Live resize of the sticker width, off by default
+
+   unsigned long m_max_section_count;
+   unsigned long m_max_item_count;   // Appends turn into edits above it
+   unsigned long m_min_resize_width;
+   unsigned long m_max_resize_width;
+
+   // Size of the collapsed sticker. Load is applied to the expanded one.
+   long m_width;
+   long m_height;
+
+   unsigned long m_seed;
+   bool m_is_display_list;   // Sticker is drawn through its display list
+};
+
+struct LoadReport
+{
+   unsigned long m_update_count;
+   unsigned long m_frame_count;           // Rendered frames
+   unsigned long m_dropped_frame_count;   // Frame slots missed because of a late frame
+   double m_duration;                     // Seconds
+   // Milliseconds from an update to the end of the frame showing it.
+   LatencyStatistics m_update_to_pixels;
+
+   double GetUpdatesPerSecond() const;
+   void Print(std::ostream& stream) const;
+};
+
+// Drives a headless sticker with random ISection updates at a fixed rate,
+// rendering it at the frame rate as a window would on WM_PAINT.
+class StickerLoadGenerator
+{
+public:
+   explicit StickerLoadGenerator(const LoadOptions& options);
+
+   LoadReport Run();
+
+private:
+   void ApplyUpdate(StickerModel& sticker);
+   void FillSection(ISection& section, unsigned long section_index);
+   unsigned long GetRandom(unsigned long limit);
+
+private:
+   LoadOptions m_options;
+   std::mt19937 m_random;
+   unsigned long m_update_index;
+   std::vector<unsigned long> m_item_counts;   // Per section
+};
@@ -1,9 +1,13 @@
 #include "window.h"
 #include "window_class.h"
 #include "sticker.h"
+#include "callback_dispatcher.h"
+#include "resource_manager.h"
 
 #include <gdiplus.h>
 #include <sstream>
+#include <thread>
+#include <functional>
 
 class GdiplusInitializer
 {
@@ -16,6 +20,7 @@ public:
 
    ~GdiplusInitializer()
    {
+      BGO::ResourceManager::GetInstance().ReleaseResources();
       Gdiplus::GdiplusShutdown(m_gdiplusToken);
    }
 
@@ -26,7 +31,7 @@ private:
 class StickerCallback : public IStickerCallback
 {
 public:
-   StickerCallback(HWND parent_window) : m_parent_window(parent_window)
+   StickerCallback()
    {
       // no code
    }
@@ -35,25 +40,30 @@ public:
    {
       std::stringstream sstream;
       sstream << "OnHeader event. Section index = " << section_index;
-      ::MessageBox(m_parent_window, sstream.str().c_str(), "Event", MB_OK);
+      ShowEvent(sstream.str());
    }
 
    virtual void OnItemClick(unsigned long section_index, unsigned long item_index) override
    {
       std::stringstream sstream;
       sstream << "OnItem event. Section index = " << section_index << ". Item index = " << item_index;
-      ::MessageBox(m_parent_window, sstream.str().c_str(), "Event", MB_OK);
+      ShowEvent(sstream.str());
    }
 
    virtual void OnFooterClick(unsigned long section_index) override
    {
       std::stringstream sstream;
       sstream << "OnFooter event. Section index = " << section_index;
-      ::MessageBox(m_parent_window, sstream.str().c_str(), "Event", MB_OK);
+      ShowEvent(sstream.str());
    }
 
 private:
-   HWND m_parent_window;
+   // Called by a thread of the executor of CallbackDispatcher. The box has no owner, as it would
+   // disable the owner and the sticker inside it, and being task modal it blocks only that thread.
+   static void ShowEvent(const std::string& text)
+   {
+      ::MessageBox(nullptr, text.c_str(), "Event", MB_OK | MB_TASKMODAL);
+   }
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
@@ -65,9 +75,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
    ::ShowWindow(main_window.GetHandle(), nCmdShow);
 
    Sticker sticker;
-   sticker.Create(nullptr, WS_CHILD|WS_VISIBLE|WS_DLGFRAME, 0, 0, 100, 22, main_window.GetHandle());
+   // Sizing frame lets the user drag the width of the expanded sticker (live resize).
+   // The collapsed sticker keeps its client area, whatever the frame is.
+   const DWORD sticker_style = WS_CHILD|WS_VISIBLE|WS_THICKFRAME;
+   RECT sticker_rect = { 0, 0, 94, 16 };
+   ::AdjustWindowRect(&sticker_rect, sticker_style, FALSE);
+   sticker.Create(nullptr, sticker_style, 0, 0, sticker_rect.right - sticker_rect.left,
+                  sticker_rect.bottom - sticker_rect.top, main_window.GetHandle());
 
-   sticker.SetCallback(std::make_unique<StickerCallback>(main_window.GetHandle()));
+   // Message boxes of the callback are shown by detached threads, so the sticker stays responsive
+   // and closing of the demo doesn't wait for a box left open: the process ends together with it.
+   sticker.SetCallback(std::make_unique<CallbackDispatcher>(std::make_unique<StickerCallback>(),
+      [](std::function<void()> task) { std::thread(std::move(task)).detach(); }));
    
    sticker.SetRedraw(false);
    {
@@ -0,0 +1,156 @@
+#include "memory_usage.h"
+
+#include <ostream>
+#include <cstdlib>
+#include <memory>
+
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif // __GNUC__
+
+namespace
+{
+
+std::string GetTypeName(const std::type_index& type)
+{
+#ifdef __GNUC__
+   auto status = 0;
+   std::unique_ptr<char, void (*)(void*)> name(
+      abi::__cxa_demangle(type.name(), nullptr, nullptr, &status), std::free);
+   if (0 == status && name)
+   {
+      return name.get();
+   }
+#endif // __GNUC__
+   return type.name();
+}
+
+template <typename TString>
+size_t GetHeapStringSize(const TString& text)
+{
+   // Short strings are stored inside the object itself.
+   const auto data = reinterpret_cast<const char*>(text.data());
+   const auto object = reinterpret_cast<const char*>(&text);
+   const auto is_local = (data >= object) && (data < object + sizeof(text));
+   return is_local ? 0 : (text.capacity() + 1) * sizeof(typename TString::value_type);
+}
+
+const auto g_bitmap_pixel_size = 4UL;
+
+} // namespace
+
+namespace BGO
+{
+
+///////////// class MemoryUsage ////////////////
+
+MemoryUsage::MemoryUsage() :
+   m_nodes(), m_string_bytes(0), m_child_vector_bytes(0), m_back_buffer_bytes(0), m_cache_bytes(0)
+{
+   // no code
+}
+
+void MemoryUsage::AddNode(const std::type_info& type, size_t bytes, unsigned long count)
+{
+   auto& node = m_nodes[std::type_index(type)];
+   node.m_count += count;
+   node.m_bytes += bytes;
+}
+
+void MemoryUsage::AddStrings(size_t bytes)
+{
+   m_string_bytes += bytes;
+}
+
+void MemoryUsage::AddChildVectors(size_t bytes)
+{
+   m_child_vector_bytes += bytes;
+}
+
+void MemoryUsage::AddBackBuffer(size_t bytes)
+{
+   m_back_buffer_bytes += bytes;
+}
+
+void MemoryUsage::AddCaches(size_t bytes)
+{
+   m_cache_bytes += bytes;
+}
+
+std::map<std::string, MemoryUsage::NodeUsage> MemoryUsage::GetNodes() const
+{
+   std::map<std::string, NodeUsage> nodes;
+   for (const auto& node : m_nodes)
+   {
+      auto& named_node = nodes[GetTypeName(node.first)];
+      named_node.m_count += node.second.m_count;
+      named_node.m_bytes += node.second.m_bytes;
+   }
+   return nodes;
+}
+
+size_t MemoryUsage::GetNodeBytes() const
+{
+   size_t bytes = 0;
+   for (const auto& node : m_nodes)
+   {
+      bytes += node.second.m_bytes;
+   }
+   return bytes;
+}
+
+size_t MemoryUsage::GetStringBytes() const
+{
+   return m_string_bytes;
+}
+
+size_t MemoryUsage::GetChildVectorBytes() const
+{
+   return m_child_vector_bytes;
+}
+
+size_t MemoryUsage::GetBackBufferBytes() const
+{
+   return m_back_buffer_bytes;
+}
+
+size_t MemoryUsage::GetCacheBytes() const
+{
+   return m_cache_bytes;
+}
+
+size_t MemoryUsage::GetTotalBytes() const
+{
+   return GetNodeBytes() + m_string_bytes + m_child_vector_bytes + m_back_buffer_bytes + m_cache_bytes;
+}
+
+void MemoryUsage::Print(std::ostream& stream) const
+{
+   for (const auto& node : GetNodes())
+   {
+      stream << node.first << ": " << node.second.m_count << " nodes, " << node.second.m_bytes << " bytes\n";
+   }
+   stream << "nodes: " << GetNodeBytes() << " bytes\n"
+          << "strings: " << m_string_bytes << " bytes\n"
+          << "child vectors: " << m_child_vector_bytes << " bytes\n"
+          << "back buffer: " << m_back_buffer_bytes << " bytes\n"
+          << "caches: " << m_cache_bytes << " bytes\n"
+          << "total: " << GetTotalBytes() << " bytes\n";
+}
+
+size_t MemoryUsage::GetStringSize(const std::string& text)
+{
+   return GetHeapStringSize(text);
+}
+
+size_t MemoryUsage::GetStringSize(const std::wstring& text)
+{
+   return GetHeapStringSize(text);
+}
+
+size_t MemoryUsage::GetBitmapSize(Gdiplus::Bitmap* bitmap)
+{
+   return (nullptr == bitmap) ? 0 : static_cast<size_t>(bitmap->GetWidth()) * bitmap->GetHeight() * g_bitmap_pixel_size;
+}
+
+} // namespace BGO
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+#include <gdiplus.h>
+
+#include <map>
+#include <string>
+#include <iosfwd>
+#include <typeinfo>
+#include <typeindex>
+
+namespace BGO
+{
+
+// Memory, used by an object tree and everything it owns, in bytes. Nodes are
+// accounted by their dynamic type. Children held by value are accounted as
+// separate nodes and excluded from the size of their parent. Resources shared
+// between stickers are not included (see ResourceManager::GetStatistics).
+class MemoryUsage
+{
+public:
+   struct NodeUsage
+   {
+      unsigned long m_count;
+      size_t m_bytes;
+   };
+
+   MemoryUsage();
+
+   // Zero count adds bytes of a derived class to an already accounted node.
+   void AddNode(const std::type_info& type, size_t bytes, unsigned long count = 1);
+   void AddStrings(size_t bytes);
+   void AddChildVectors(size_t bytes);
+   void AddBackBuffer(size_t bytes);
+   void AddCaches(size_t bytes);
+
+   // Usage per node type, by readable type name.
+   std::map<std::string, NodeUsage> GetNodes() const;
+   size_t GetNodeBytes() const;
+   size_t GetStringBytes() const;
+   size_t GetChildVectorBytes() const;
+   size_t GetBackBufferBytes() const;
+   size_t GetCacheBytes() const;
+   size_t GetTotalBytes() const;
+
+   void Print(std::ostream& stream) const;
+
+   // Heap memory of the string, zero for strings kept inside the object.
+   static size_t GetStringSize(const std::string& text);
+   static size_t GetStringSize(const std::wstring& text);
+   // Pixel memory of the bitmap, all bitmaps of stickers are 32 bpp.
+   static size_t GetBitmapSize(Gdiplus::Bitmap* bitmap);
+
+private:
+   std::map<std::type_index, NodeUsage> m_nodes;
+   size_t m_string_bytes;
+   size_t m_child_vector_bytes;
+   size_t m_back_buffer_bytes;
+   size_t m_cache_bytes;
+};
+
+} // namespace BGO
@@ -0,0 +1,60 @@
+#include "render_quality.h"
+
+namespace
+{
+
+//////////// Constants /////////////
+
+// Weight of the last frame in the moving average of frame time.
+const auto g_frame_time_weight = 0.25;
+
+} // namespace
+
+/////////////// struct RenderQualityTier /////////////////
+
+RenderQualityTier RenderQualityTier::GetDefault(RenderQuality quality)
+{
+   if (RenderQuality::Fast == quality)
+   {
+      return RenderQualityTier{ Gdiplus::TextRenderingHintSingleBitPerPixelGridFit, Gdiplus::SmoothingModeHighSpeed };
+   }
+   return RenderQualityTier{ Gdiplus::TextRenderingHintClearTypeGridFit, Gdiplus::SmoothingModeAntiAlias };
+}
+
+void RenderQualityTier::Apply(Gdiplus::Graphics* graphics) const
+{
+   graphics->SetTextRenderingHint(m_text_rendering_hint);
+   graphics->SetSmoothingMode(m_smoothing_mode);
+}
+
+/////////////// class RenderQualityPolicy /////////////////
+
+RenderQualityPolicy::RenderQualityPolicy(double frame_budget) :
+   m_frame_budget(frame_budget), m_high_frame_time(0.0)
+{
+   // no code
+}
+
+void RenderQualityPolicy::SetFrameBudget(double frame_budget)
+{
+   m_frame_budget = frame_budget;
+}
+
+double RenderQualityPolicy::GetFrameBudget() const
+{
+   return m_frame_budget;
+}
+
+RenderQuality RenderQualityPolicy::GetQuality(bool is_interactive) const
+{
+   return (!is_interactive || m_high_frame_time <= m_frame_budget) ? RenderQuality::High : RenderQuality::Fast;
+}
+
+void RenderQualityPolicy::AddFrame(RenderQuality quality, double milliseconds)
+{
+   if (RenderQuality::High == quality)
+   {
+      m_high_frame_time = (0.0 == m_high_frame_time) ?
+         milliseconds : m_high_frame_time + g_frame_time_weight * (milliseconds - m_high_frame_time);
+   }
+}
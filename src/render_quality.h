@@ -0,0 +1,40 @@
+#pragma once
+
+#include <windows.h>
+#include <gdiplus.h>
+
+// Fast quality is used for frames, which are replaced soon (resize, animation),
+// high quality is used for the settled sticker.
+enum class RenderQuality { Fast, High };
+
+// Settings of graphics for one quality.
+struct RenderQualityTier
+{
+   Gdiplus::TextRenderingHint m_text_rendering_hint;
+   Gdiplus::SmoothingMode m_smoothing_mode;
+
+   static RenderQualityTier GetDefault(RenderQuality quality);
+   void Apply(Gdiplus::Graphics* graphics) const;
+};
+
+// Chooses quality of frames. Settled frames are always rendered in high quality. Interactive
+// ones are rendered so too, while the measured time of high quality frames fits the frame
+// budget, otherwise they fall back to fast quality till high quality gets cheaper.
+class RenderQualityPolicy
+{
+public:
+   // Budget is in milliseconds.
+   explicit RenderQualityPolicy(double frame_budget);
+
+   void SetFrameBudget(double frame_budget);
+   double GetFrameBudget() const;
+
+   RenderQuality GetQuality(bool is_interactive) const;
+   // Reports time of a rendered frame, milliseconds.
+   void AddFrame(RenderQuality quality, double milliseconds);
+
+private:
+   double m_frame_budget;
+   // Moving average of high quality frames, zero till the first one.
+   double m_high_frame_time;
+};
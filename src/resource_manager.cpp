@@ -0,0 +1,286 @@
+#include "resource_manager.h"
+
+#include <tuple>
+#include <cassert>
+
+namespace BGO
+{
+
+/////////// struct ResourceStatistics //////////
+
+double ResourceStatistics::GetSharingRatio() const
+{
+   return (0 == m_alive) ? 0.0 : static_cast<double>(m_references) / m_alive;
+}
+
+/////////// struct TextMetricsKey //////////
+
+bool TextMetricsKey::operator<(const TextMetricsKey& rhs) const
+{
+   return std::tie(m_text, m_font, m_width, m_dpi, m_rendering_hint, m_is_wrapped) <
+          std::tie(rhs.m_text, rhs.m_font, rhs.m_width, rhs.m_dpi, rhs.m_rendering_hint, rhs.m_is_wrapped);
+}
+
+/////////// struct TextMetrics //////////
+
+bool TextMetrics::IsMeasuredFor(const FontKey& font, unsigned long width, Gdiplus::REAL dpi,
+                                Gdiplus::TextRenderingHint rendering_hint, bool is_wrapped) const
+{
+   return m_key.m_width == width && m_key.m_dpi == dpi && m_key.m_rendering_hint == rendering_hint &&
+          m_key.m_is_wrapped == is_wrapped && m_key.m_font == font;
+}
+
+/////////// class ResourceManager //////////
+
+ResourceManager::ResourceManager() :
+   m_fonts(), m_brushes(), m_text_metrics(), m_text_advances(), m_image_atlases(),
+   m_text_style_mutex(), m_text_style_blocks(), m_text_style_count(0), m_text_style_indexes(), m_text_style_tables(),
+   m_text_style_requests(0)
+{
+   // no code
+}
+
+ResourceManager& ResourceManager::GetInstance()
+{
+   // Destroyed after GDI+ shutdown, so ReleaseResources() must be called before it.
+   static ResourceManager manager;
+   return manager;
+}
+
+std::shared_ptr<const Gdiplus::Font> ResourceManager::GetFont(const FontKey& key)
+{
+   return m_fonts.Get(std::make_pair(std::this_thread::get_id(), key), [&key]()
+   {
+      return new Gdiplus::Font(key.m_name.c_str(), key.m_size, key.m_style);
+   });
+}
+
+std::shared_ptr<const Gdiplus::SolidBrush> ResourceManager::GetBrush(Gdiplus::ARGB color)
+{
+   return m_brushes.Get(std::make_pair(std::this_thread::get_id(), color), [color]()
+   {
+      return new Gdiplus::SolidBrush(Gdiplus::Color(color));
+   });
+}
+
+std::shared_ptr<const TextMetrics> ResourceManager::GetTextMetrics(
+   const TextMetricsKey& key, Gdiplus::Graphics* graphics)
+{
+   return m_text_metrics.Get(key, [this, &key, graphics]()
+   {
+      if (key.m_is_wrapped)
+      {
+         return WrapText(key, graphics);
+      }
+
+      const auto font = GetFont(key.m_font);
+      const Gdiplus::RectF origin_rect(0, 0, static_cast<Gdiplus::REAL>(key.m_width), 0);
+
+      Gdiplus::RectF boundary;
+      graphics->MeasureString(key.m_text.c_str(), key.m_text.size(), font.get(), origin_rect, &boundary);
+
+      return new TextMetrics{ key, boundary.Width, boundary.Height, {}, boundary.Height, nullptr };
+   });
+}
+
+std::shared_ptr<const TextAdvances> ResourceManager::GetTextAdvances(
+   const TextMetricsKey& key, Gdiplus::Graphics* graphics)
+{
+   return m_text_advances.Get(key, [this, &key, graphics]()
+   {
+      const auto font = GetFont(key.m_font);
+      const auto& text = key.m_text;
+
+      // Typographic format measures the glyphs only, so words add up to the line.
+      Gdiplus::StringFormat format(Gdiplus::StringFormat::GenericTypographic());
+      Gdiplus::StringFormat spaced_format(Gdiplus::StringFormat::GenericTypographic());
+      spaced_format.SetFormatFlags(spaced_format.GetFormatFlags() | Gdiplus::StringFormatFlagsMeasureTrailingSpaces);
+
+      const auto measure = [&text, &font, graphics](size_t start, size_t length, const Gdiplus::StringFormat& format)
+      {
+         Gdiplus::RectF boundary;
+         graphics->MeasureString(text.c_str() + start, static_cast<INT>(length), font.get(),
+                                 Gdiplus::PointF(0, 0), &format, &boundary);
+         return boundary.Width;
+      };
+      const auto is_space = [](wchar_t symbol)
+      {
+         return L' ' == symbol || L'\t' == symbol;
+      };
+
+      auto advances = new TextAdvances{ {}, font->GetHeight(graphics) };
+      for (size_t start = 0; start < text.size();)
+      {
+         auto end = start;
+         while (end < text.size() && !is_space(text[end]) && L'\n' != text[end])
+         {
+            ++end;
+         }
+         auto next = end;
+         while (next < text.size() && is_space(text[next]))
+         {
+            ++next;
+         }
+         const auto is_line_end = next < text.size() && L'\n' == text[next];
+
+         const auto length = end - start;
+         const auto width = (0 == length) ? 0 : measure(start, length, format);
+         const auto advance = (next == end) ? width : measure(start, next - start, spaced_format);
+         advances->m_words.push_back(TextAdvances::Word{
+            static_cast<unsigned long>(start), static_cast<unsigned long>(length), width, advance, is_line_end });
+
+         start = is_line_end ? next + 1 : next;
+      }
+      return advances;
+   });
+}
+
+TextMetrics* ResourceManager::WrapText(const TextMetricsKey& key, Gdiplus::Graphics* graphics)
+{
+   auto advances_key = key;
+   advances_key.m_width = 0;
+   auto advances = GetTextAdvances(advances_key, graphics);
+
+   // Greedy wrapping, a word longer than the width takes a line of its own.
+   const auto max_width = static_cast<Gdiplus::REAL>(key.m_width);
+   auto metrics = new TextMetrics{ key, 0, 0, {}, advances->m_line_height, advances };
+   auto line = TextLine{ 0, 0, 0 };
+   auto line_advance = Gdiplus::REAL(0);
+   auto is_line_empty = true;
+
+   const auto end_line = [metrics, &line, &line_advance, &is_line_empty]()
+   {
+      metrics->m_lines.push_back(line);
+      metrics->m_width = (std::max)(metrics->m_width, line.m_width);
+      line_advance = 0;
+      is_line_empty = true;
+   };
+
+   for (const auto& word : advances->m_words)
+   {
+      if (!is_line_empty && 0 != key.m_width && line_advance + word.m_width > max_width)
+      {
+         end_line();
+      }
+      if (is_line_empty)
+      {
+         line = TextLine{ word.m_start, 0, 0 };
+         is_line_empty = false;
+      }
+      line.m_length = word.m_start + word.m_length - line.m_start;
+      line.m_width = line_advance + word.m_width;
+      line_advance += word.m_advance;
+
+      if (word.m_is_line_end)
+      {
+         end_line();
+      }
+   }
+   if (!is_line_empty)
+   {
+      end_line();
+   }
+
+   metrics->m_height = metrics->m_line_height * metrics->m_lines.size();
+   return metrics;
+}
+
+TextStyleIndex ResourceManager::GetTextStyleIndex(const TextStyleParams& params)
+{
+   std::lock_guard<std::mutex> lock(m_text_style_mutex);
+   ++m_text_style_requests;
+
+   const auto found = m_text_style_indexes.find(params);
+   if (found != m_text_style_indexes.end())
+   {
+      return found->second;
+   }
+
+   // Index space is large enough for widths and colors of a long session. If it's used up
+   // anyway, the text keeps a valid style of a wrong look instead of overwriting one in use.
+   assert(m_text_style_count < MaxTextStyleCount);
+   if (m_text_style_count >= MaxTextStyleCount)
+   {
+      return 0;
+   }
+
+   const auto index = static_cast<TextStyleIndex>(m_text_style_count);
+   auto& block = m_text_style_blocks[index / TextStyleBlockSize];
+   if (!block)
+   {
+      block.reset(new TTextStyleBlock());
+   }
+   (*block)[index % TextStyleBlockSize].reset(new TextStyle(params));
+   ++m_text_style_count;
+
+   m_text_style_indexes.emplace(params, index);
+   return index;
+}
+
+const TextStyle& ResourceManager::GetTextStyle(TextStyleIndex index) const
+{
+   const auto& block = m_text_style_blocks[index / TextStyleBlockSize];
+   assert(block && (*block)[index % TextStyleBlockSize]);
+   return *(*block)[index % TextStyleBlockSize];
+}
+
+const TextStyleTable& ResourceManager::GetTextStyleTable(TextStyleIndex index)
+{
+   // Only the calling thread uses its tables, and nodes of the map don't move.
+   auto& tables = GetThreadTextStyleTables();
+   if (!tables)
+   {
+      std::lock_guard<std::mutex> lock(m_text_style_mutex);
+      tables = &m_text_style_tables[std::this_thread::get_id()];
+   }
+
+   if (tables->size() <= index)
+   {
+      tables->resize(index + 1);
+   }
+   auto& table = (*tables)[index];
+   if (!table)
+   {
+      table.reset(new TextStyleTable(GetTextStyle(index)));
+   }
+   return *table;
+}
+
+void ResourceManager::ReleaseThreadResources()
+{
+   std::lock_guard<std::mutex> lock(m_text_style_mutex);
+   m_text_style_tables.erase(std::this_thread::get_id());
+   GetThreadTextStyleTables() = nullptr;
+}
+
+void ResourceManager::ReleaseResources()
+{
+   std::lock_guard<std::mutex> lock(m_text_style_mutex);
+   m_text_style_tables.clear();
+   GetThreadTextStyleTables() = nullptr;
+}
+
+ResourceManager::TTextStyleTables*& ResourceManager::GetThreadTextStyleTables()
+{
+   thread_local TTextStyleTables* tables = nullptr;
+   return tables;
+}
+
+ResourceManager::Statistics ResourceManager::GetStatistics() const
+{
+   Statistics statistics;
+   statistics.m_fonts = m_fonts.GetStatistics();
+   statistics.m_brushes = m_brushes.GetStatistics();
+   {
+      // Styles are never released, every request counts as a reference.
+      std::lock_guard<std::mutex> lock(m_text_style_mutex);
+      const auto count = m_text_style_count;
+      statistics.m_text_styles = ResourceStatistics{ m_text_style_requests, count, count, m_text_style_requests };
+   }
+   statistics.m_text_metrics = m_text_metrics.GetStatistics();
+   statistics.m_text_advances = m_text_advances.GetStatistics();
+   statistics.m_image_atlases = m_image_atlases.GetStatistics();
+   return statistics;
+}
+
+} // namespace BGO
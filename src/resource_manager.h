@@ -0,0 +1,278 @@
+#pragma once
+
+#include "graphic_objects.h"
+
+#include <map>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <iterator>
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace BGO
+{
+
+// Usage of one kind of shared resources.
+struct ResourceStatistics
+{
+   unsigned long m_requests;   // Amount of requests
+   unsigned long m_created;    // Amount of created resources, the rest of requests were shared
+   unsigned long m_alive;      // Amount of distinct resources, alive now
+   unsigned long m_references; // Amount of references to the alive resources
+
+   // Average amount of references to one alive resource.
+   double GetSharingRatio() const;
+};
+
+struct TextMetricsKey
+{
+   std::wstring m_text;
+   FontKey m_font;
+   unsigned long m_width;
+   Gdiplus::REAL m_dpi;
+   Gdiplus::TextRenderingHint m_rendering_hint;
+   bool m_is_wrapped;
+
+   bool operator<(const TextMetricsKey& rhs) const;
+};
+
+// Advances of the words of a text, measured once for all widths it is wrapped at.
+// Word is a run of characters with the spaces after it.
+struct TextAdvances
+{
+   struct Word
+   {
+      unsigned long m_start;
+      unsigned long m_length;         // Without the trailing spaces
+      Gdiplus::REAL m_width;          // Without the trailing spaces
+      Gdiplus::REAL m_advance;        // With the trailing spaces
+      bool m_is_line_end;             // Followed by a line feed
+   };
+
+   std::vector<Word> m_words;
+   Gdiplus::REAL m_line_height;
+};
+
+// Line of a wrapped text.
+struct TextLine
+{
+   unsigned long m_start;
+   unsigned long m_length;
+   Gdiplus::REAL m_width;
+};
+
+// Size of the text, measured once for all texts with the same key.
+struct TextMetrics
+{
+   TextMetricsKey m_key;
+   Gdiplus::REAL m_width;
+   Gdiplus::REAL m_height;
+
+   // Line breaks of a wrapped text, empty otherwise. Advances are kept alive
+   // while the text uses these metrics, so its reflow to a new width hits them.
+   std::vector<TextLine> m_lines;
+   Gdiplus::REAL m_line_height;
+   std::shared_ptr<const TextAdvances> m_advances;
+
+   bool IsMeasuredFor(const FontKey& font, unsigned long width, Gdiplus::REAL dpi,
+                      Gdiplus::TextRenderingHint rendering_hint, bool is_wrapped) const;
+};
+
+// Set of resources, shared by key. Registry doesn't own resources, they are
+// released with the last reference, so no GDI+ object outlives GDI+ shutdown.
+// Resources are created without the lock (e.g. a text is measured), so threads don't
+// wait for each other's creation. Of the same resource created at once the first one wins.
+template <typename TKey, typename TResource>
+class SharedRegistry
+{
+public:
+   SharedRegistry();
+
+   template <typename TFactory>
+   std::shared_ptr<const TResource> Get(const TKey& key, TFactory&& factory);
+
+   ResourceStatistics GetStatistics() const;
+
+private:
+   void RemoveExpired();
+
+private:
+   mutable std::mutex m_mutex;
+   std::map<TKey, std::weak_ptr<const TResource>> m_resources;
+   unsigned long m_requests;
+   unsigned long m_created;
+   unsigned long m_cleanup_size;
+};
+
+// Process-wide manager of resources, shared by all stickers. GDI+ objects can't be
+// used by several threads at once (GDI+ reports ObjectBusy), so fonts, brushes, style
+// tables and images are shared within a thread. Text styles and metrics are plain data
+// and shared by all threads.
+class ResourceManager
+{
+   ResourceManager();
+   ResourceManager(const ResourceManager& rhs) = delete;
+
+public:
+   static ResourceManager& GetInstance();
+
+   std::shared_ptr<const Gdiplus::Font> GetFont(const FontKey& key);
+   std::shared_ptr<const Gdiplus::SolidBrush> GetBrush(Gdiplus::ARGB color);
+   std::shared_ptr<const TextMetrics> GetTextMetrics(const TextMetricsKey& key, Gdiplus::Graphics* graphics);
+
+   // Styles are registered once per params and live as long as the process. Getting
+   // a style by its index takes no lock, so layout of texts doesn't serialize threads.
+   // Once MaxTextStyleCount styles are registered, new params get the first style.
+   TextStyleIndex GetTextStyleIndex(const TextStyleParams& params);
+   const TextStyle& GetTextStyle(TextStyleIndex index) const;
+   // Table is created for the calling thread and is valid until its release. Tables of
+   // the thread are looked up under the lock once, later calls take no lock.
+   const TextStyleTable& GetTextStyleTable(TextStyleIndex index);
+
+   // Style tables are owned by the manager, so they must be released before
+   // GDI+ shutdown, and by worker threads before their exit. All of them are
+   // released, when no other thread draws.
+   void ReleaseThreadResources();
+   void ReleaseResources();
+
+   // Factory is called once, while the atlas with such a name is alive.
+   template <typename TFactory>
+   std::shared_ptr<const ImageAtlas> GetImageAtlas(const std::wstring& name, TFactory&& factory);
+
+   struct Statistics
+   {
+      ResourceStatistics m_fonts;
+      ResourceStatistics m_brushes;
+      ResourceStatistics m_text_styles;
+      ResourceStatistics m_text_metrics;
+      ResourceStatistics m_text_advances;
+      ResourceStatistics m_image_atlases;
+   };
+
+   Statistics GetStatistics() const;
+
+private:
+   // Key has zero width, advances don't depend on it.
+   std::shared_ptr<const TextAdvances> GetTextAdvances(const TextMetricsKey& key, Gdiplus::Graphics* graphics);
+   TextMetrics* WrapText(const TextMetricsKey& key, Gdiplus::Graphics* graphics);
+
+private:
+   template <typename TKey>
+   using TThreadKey = std::pair<std::thread::id, TKey>;
+
+   SharedRegistry<TThreadKey<FontKey>, Gdiplus::Font> m_fonts;
+   SharedRegistry<TThreadKey<Gdiplus::ARGB>, Gdiplus::SolidBrush> m_brushes;
+   SharedRegistry<TextMetricsKey, TextMetrics> m_text_metrics;
+   SharedRegistry<TextMetricsKey, TextAdvances> m_text_advances;
+   SharedRegistry<TThreadKey<std::wstring>, ImageAtlas> m_image_atlases;
+
+   using TTextStyleTables = std::vector<std::unique_ptr<const TextStyleTable>>;
+   // Tables of the calling thread in m_text_style_tables, null till its first table.
+   static TTextStyleTables*& GetThreadTextStyleTables();
+
+   // Index space of styles is split into blocks, allocated on demand. Blocks and styles never
+   // move, and an index is handed out only after its style is stored, so readers need no lock.
+   static constexpr unsigned long TextStyleBlockSize = 4096;
+   static constexpr unsigned long TextStyleBlockCount = 4096;
+   static constexpr unsigned long MaxTextStyleCount = TextStyleBlockSize * TextStyleBlockCount;
+   using TTextStyleBlock = std::array<std::unique_ptr<const TextStyle>, TextStyleBlockSize>;
+   using TTextStyleBlocks = std::array<std::unique_ptr<TTextStyleBlock>, TextStyleBlockCount>;
+
+   mutable std::mutex m_text_style_mutex;
+   TTextStyleBlocks m_text_style_blocks;
+   unsigned long m_text_style_count;
+   std::map<TextStyleParams, TextStyleIndex> m_text_style_indexes;
+   std::map<std::thread::id, TTextStyleTables> m_text_style_tables;
+   unsigned long m_text_style_requests;
+};
+
+///////////// class SharedRegistry ////////////////
+
+template <typename TKey, typename TResource>
+SharedRegistry<TKey, TResource>::SharedRegistry() :
+   m_mutex(), m_resources(), m_requests(0), m_created(0), m_cleanup_size(64)
+{
+   // no code
+}
+
+template <typename TKey, typename TResource>
+template <typename TFactory>
+std::shared_ptr<const TResource> SharedRegistry<TKey, TResource>::Get(const TKey& key, TFactory&& factory)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_requests;
+
+      const auto found = m_resources.find(key);
+      if (found != m_resources.end())
+      {
+         auto resource = found->second.lock();
+         if (resource)
+         {
+            return resource;
+         }
+      }
+   }
+
+   // Declared before the lock, so the loser of a race is released without the lock.
+   const std::shared_ptr<const TResource> created(factory());
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   auto& weak_resource = m_resources[key];
+   auto resource = weak_resource.lock();
+   if (!resource)
+   {
+      resource = created;
+      weak_resource = resource;
+      ++m_created;
+
+      if (m_resources.size() >= m_cleanup_size)
+      {
+         RemoveExpired();
+      }
+   }
+   return resource;
+}
+
+template <typename TKey, typename TResource>
+ResourceStatistics SharedRegistry<TKey, TResource>::GetStatistics() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   ResourceStatistics statistics = { m_requests, m_created, 0, 0 };
+   for (const auto& resource : m_resources)
+   {
+      const auto use_count = resource.second.use_count();
+      if (use_count > 0)
+      {
+         ++statistics.m_alive;
+         statistics.m_references += use_count;
+      }
+   }
+   return statistics;
+}
+
+template <typename TKey, typename TResource>
+void SharedRegistry<TKey, TResource>::RemoveExpired()
+{
+   for (auto iter = m_resources.begin(); iter != m_resources.end();)
+   {
+      iter = iter->second.expired() ? m_resources.erase(iter) : std::next(iter);
+   }
+   // Amortize clean-up by doubling the limit relative to the alive resources.
+   m_cleanup_size = (std::max)(64UL, static_cast<unsigned long>(m_resources.size() * 2));
+}
+
+///////////// class ResourceManager ////////////////
+
+template <typename TFactory>
+std::shared_ptr<const ImageAtlas> ResourceManager::GetImageAtlas(const std::wstring& name, TFactory&& factory)
+{
+   return m_image_atlases.Get(std::make_pair(std::this_thread::get_id(), name), std::forward<TFactory>(factory));
+}
+
+} // namespace BGO
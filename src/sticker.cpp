@@ -1,24 +1,47 @@
 #include "sticker.h"
 #include "sticker_objects.h"
+#include "input_replay.h"
+#include "display_list.h"
 
 // For GET_X_LPARAM
 #include <windowsx.h>
 
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 
 namespace
 {
 
+//////////// Constants /////////////
+
+const auto g_hosted_frame_width = 1L;
+const auto g_transition_timer_id = 1U;
+const auto g_transition_frame_interval = 16U;   // Milliseconds, about 60 fps
+const auto g_transition_duration = 150.0;       // Milliseconds
+const auto g_idle_timer_id = 2U;
+const auto g_idle_delay = 200U;                 // Milliseconds after the last paint
+const auto g_hit_test_cell_size = 128L;
+const Gdiplus::Color g_host_back_color(0xFF, 0xFF, 0xFF);
+const Gdiplus::Color g_hosted_frame_color(0x99, 0x99, 0x99);
+
 //////////// Utilities /////////////
 
 inline std::unique_ptr<Gdiplus::Graphics> GetGraphics(
-   const std::unique_ptr<Gdiplus::Bitmap>& image)
+   const std::unique_ptr<Gdiplus::Bitmap>& image, const RenderQualityTier& tier)
 {
    std::unique_ptr<Gdiplus::Graphics> graphics(Gdiplus::Graphics::FromImage(image.get()));
-   graphics->SetTextRenderingHint(Gdiplus::TextRenderingHintSingleBitPerPixelGridFit);
+   tier.Apply(graphics.get());
    return graphics;
 }
 
+// Layout is always measured in high quality, so it doesn't change with the quality of frames.
+inline std::unique_ptr<Gdiplus::Graphics> GetGraphics(
+   const std::unique_ptr<Gdiplus::Bitmap>& image)
+{
+   return GetGraphics(image, RenderQualityTier::GetDefault(RenderQuality::High));
+}
+
 inline void InvalidateRectF(HWND wnd, const Gdiplus::RectF& rectf)
 {
    const RECT rect =
@@ -43,63 +66,481 @@ IStickerCallback::~IStickerCallback()
    // no code
 }
 
-/////////////// class Sticker /////////////////
+/////////////// class StickerModel /////////////////
 
-Sticker::Sticker() : wc::Window(),
+StickerModel::StickerModel() :
    m_is_dirty(true),
    m_is_redraw(true),
-   m_is_mouse_tracking(false),
-   m_memory_image(),
+   m_is_animated(false),
+   m_click_latency(),
    m_callback(),
-   m_object(new SGO::StickerObject(*this))
+   m_object(new SGO::StickerObject(*this)),
+   m_data_source(),
+   m_display_list(),
+   m_is_display_list_valid(false)
 {
    // no code
 }
 
-Sticker::~Sticker()
+StickerModel::~StickerModel()
 {
    // no code
 }
 
-void Sticker::SetDirty()
+void StickerModel::SetDirty()
 {
    m_is_dirty = true;
+   m_is_display_list_valid = false;
+   m_object->DiscardExpandedLayout();
 }
 
-void Sticker::SetRedraw(bool is_redraw)
+void StickerModel::SetRedraw(bool is_redraw)
 {
    m_is_redraw = is_redraw;
    Update();
 }
 
-void Sticker::Update()
+void StickerModel::Update()
 {
    if (m_is_redraw && m_is_dirty)
    {
-      ::InvalidateRect(GetHandle(), nullptr, FALSE);
+      Invalidate();
    }
 }
 
-void Sticker::SetSectionCount(unsigned long count)
+void StickerModel::SetSectionCount(unsigned long count)
 {
    m_object->SetSectionCount(count);
 }
 
-ISection& Sticker::GetSection(unsigned long index)
+unsigned long StickerModel::GetSectionCount() const
+{
+   return m_object->GetSectionCount();
+}
+
+ISection& StickerModel::GetSection(unsigned long index)
 {
    return m_object->GetSection(index);
 }
 
-void Sticker::SetCallback(std::unique_ptr<IStickerCallback>&& callback)
+unsigned long StickerModel::GetShownSectionCount() const
+{
+   return m_object->GetShownSectionCount();
+}
+
+bool StickerModel::IsSectionExpanded(unsigned long index) const
+{
+   return m_object->IsSectionExpanded(index);
+}
+
+void StickerModel::SetCallback(std::unique_ptr<IStickerCallback>&& callback)
 {
    m_callback = std::move(callback);
 }
 
-IStickerCallback* Sticker::GetCallback() const
+IStickerCallback* StickerModel::GetCallback() const
 {
    return m_callback.get();
 }
 
+void StickerModel::SetDataSource(std::unique_ptr<IStickerDataSource>&& source, const DataSourceOptions& options)
+{
+   if (!source)
+   {
+      m_data_source.reset();
+      return;
+   }
+
+   m_data_source.reset(new DataSourceCache(std::move(source), options));
+   ReloadDataSource();
+}
+
+void StickerModel::ReloadDataSource()
+{
+   if (!m_data_source)
+   {
+      return;
+   }
+
+   // Content is pulled again on the next layout and overwrites the pulled one.
+   const auto count = m_data_source->GetSource().GetSectionCount();
+   m_data_source->Reset(count);
+   SetDirty();
+   m_object->SetSectionCount(count);
+}
+
+bool StickerModel::HasMoreItems(unsigned long section_index) const
+{
+   return m_data_source && m_data_source->IsContentPulled(section_index) &&
+          m_data_source->GetPulledItemCount(section_index) < m_data_source->GetSource().GetItemCount(section_index);
+}
+
+bool StickerModel::PullMoreItems(unsigned long section_index)
+{
+   if (!HasMoreItems(section_index))
+   {
+      return false;
+   }
+
+   auto& source = m_data_source->GetSource();
+   auto& section = m_object->GetSection(section_index);
+   const auto first = m_data_source->GetPulledItemCount(section_index);
+   const auto count = (std::min)(source.GetItemCount(section_index) - first, m_data_source->GetOptions().m_item_page_size);
+
+   // Unlike pulling before a layout, the page is shown as any other change of the content.
+   section.SetItemCount(first + count);
+   source.FillItems(section_index, first, count, section);
+   m_data_source->SetPulledItemCount(section_index, first + count);
+   return true;
+}
+
+void StickerModel::SetCollapsed(bool is_collapsed)
+{
+   if (m_object->SetCollapsed(is_collapsed))
+   {
+      m_is_dirty = true;
+   }
+   Update();
+}
+
+bool StickerModel::GetCollapsed() const
+{
+   return m_object->GetCollapsed();
+}
+
+void StickerModel::SetWidth(unsigned long width)
+{
+   m_object->SetWidth(width);
+   Update();
+}
+
+unsigned long StickerModel::GetWidth() const
+{
+   return m_object->GetWidth();
+}
+
+void StickerModel::SetLiveResize(bool is_live_resize)
+{
+   m_object->SetLiveResize(is_live_resize);
+}
+
+void StickerModel::SetAnimated(bool is_animated)
+{
+   m_is_animated = is_animated;
+}
+
+void StickerModel::SetDisplayListMode(bool is_enabled)
+{
+   if (is_enabled != static_cast<bool>(m_display_list))
+   {
+      m_display_list.reset(is_enabled ? new BGO::DisplayList() : nullptr);
+      m_is_display_list_valid = false;
+   }
+}
+
+void StickerModel::SaveDisplayList(std::ostream& stream) const
+{
+   BGO::DisplayList list;
+   list.Record(*m_object);
+   list.Save(stream);
+}
+
+BGO::MemoryUsage StickerModel::GetMemoryUsage() const
+{
+   BGO::MemoryUsage usage;
+   CollectMemoryUsage(usage);
+   return usage;
+}
+
+ClickLatency& StickerModel::GetClickLatency()
+{
+   return m_click_latency;
+}
+
+const ClickLatency& StickerModel::GetClickLatency() const
+{
+   return m_click_latency;
+}
+
+void StickerModel::CollectMemoryUsage(BGO::MemoryUsage& usage) const
+{
+   m_object->CollectMemoryUsage(usage);
+   if (m_display_list)
+   {
+      usage.AddCaches(m_display_list->GetMemorySize());
+   }
+   if (m_data_source)
+   {
+      usage.AddCaches(m_data_source->GetMemorySize());
+   }
+}
+
+void StickerModel::Initialize(const RECT& boundary)
+{
+   m_object->Initialize(boundary);
+}
+
+const Gdiplus::RectF& StickerModel::GetBoundary() const
+{
+   return m_object->GetBoundary();
+}
+
+const Gdiplus::RectF& StickerModel::GetCollapsedBoundary() const
+{
+   return m_object->GetCollapsedBoundary();
+}
+
+bool StickerModel::RecalculateIfDirty(Gdiplus::Graphics* graphics)
+{
+   if (m_is_dirty)
+   {
+      PullDataSource();
+      m_object->RecalculateBoundary(0, 0, graphics);
+      m_is_dirty = false;
+      m_is_display_list_valid = false;
+      return true;
+   }
+   return false;
+}
+
+void StickerModel::Draw(Gdiplus::Graphics* graphics) const
+{
+   if (!m_display_list)
+   {
+      m_object->Draw(graphics);
+      return;
+   }
+
+   RecordIfInvalid();
+   m_display_list->Replay(graphics);
+}
+
+void StickerModel::Draw(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const
+{
+   graphics->SetClip(rect);
+   if (!m_display_list)
+   {
+      m_object->Draw(graphics, rect);
+   }
+   else
+   {
+      // Recorded once per frame, the following rects of the frame replay the same list.
+      RecordIfInvalid();
+      m_display_list->Replay(graphics, rect);
+   }
+   graphics->ResetClip();
+}
+
+void StickerModel::RecordIfInvalid() const
+{
+   if (!m_is_display_list_valid)
+   {
+      m_display_list->Clear();
+      m_display_list->Record(*m_object);
+      m_is_display_list_valid = true;
+   }
+}
+
+void StickerModel::DrawObject(Gdiplus::Graphics* graphics, const BGO::Object& object) const
+{
+   if (!m_display_list || !m_is_display_list_valid || !m_display_list->Replay(graphics, object))
+   {
+      object.Draw(graphics);
+   }
+}
+
+void StickerModel::PrepareExpandedLayout(Gdiplus::Graphics* graphics, bool is_rendered)
+{
+   // The shown layout is restored, but the tree is laid out anew meanwhile.
+   m_object->PrepareExpandedLayout(graphics, is_rendered);
+   m_is_display_list_valid = false;
+}
+
+bool StickerModel::IsExpandedLayoutPrepared() const
+{
+   return m_object->IsExpandedLayoutPrepared();
+}
+
+bool StickerModel::ProcessClick(long x, long y, Gdiplus::Graphics* graphics)
+{
+   if (m_is_animated)
+   {
+      m_object->SaveTransitionStart();
+   }
+
+   const auto click = m_object->ProcessClick(x, y);
+   m_click_latency.Mark(ClickStage::Click);
+
+   if (BGO::Object::ClickType::ClickDoneNeedResize == click)
+   {
+      // E.g. the expanded section or the sections revealed by "More" are pulled.
+      PullDataSource();
+      m_object->RecalculateBoundary(0, 0, graphics);
+      m_click_latency.Mark(ClickStage::Layout);
+      m_is_dirty = false;
+      m_is_display_list_valid = false;
+      if (m_is_animated)
+      {
+         m_object->StartTransition();
+      }
+      return true;
+   }
+   return false;
+}
+
+void StickerModel::ProcessHover(long x, long y, std::vector<BGO::Object*>& invalidated_objects)
+{
+   m_object->ProcessHover(x, y, invalidated_objects);
+
+   if (m_display_list && m_is_display_list_valid)
+   {
+      for (const auto object : invalidated_objects)
+      {
+         if (!m_display_list->Rerecord(*object))
+         {
+            m_is_display_list_valid = false;
+            break;
+         }
+      }
+   }
+}
+
+bool StickerModel::IsTransitionActive() const
+{
+   return m_object->IsTransitionActive();
+}
+
+bool StickerModel::AdvanceTransition(double progress, std::vector<Gdiplus::RectF>& damaged_rects)
+{
+   // Offsets of the sliding objects are part of the recorded commands.
+   m_is_display_list_valid = false;
+   return m_object->AdvanceTransition(progress, damaged_rects);
+}
+
+void StickerModel::PullDataSource()
+{
+   if (!m_data_source)
+   {
+      return;
+   }
+
+   // Pulled content is laid out by the caller, the setters must not invalidate the sticker.
+   const auto is_redraw = m_is_redraw;
+   m_is_redraw = false;
+
+   auto& source = m_data_source->GetSource();
+   const auto& options = m_data_source->GetOptions();
+   const auto count = m_object->GetSectionCount();
+   const auto shown_count = m_object->GetShownSectionCount();
+
+   // Titles of the sections revealed by "More" are prefetched.
+   const auto title_count = (std::min)(count, shown_count + options.m_prefetch_count);
+   for (auto index = 0UL; index < title_count; ++index)
+   {
+      if (!m_data_source->IsTitlePulled(index))
+      {
+         source.FillTitle(index, m_object->GetSection(index));
+         m_data_source->SetTitlePulled(index);
+      }
+   }
+
+   // Collapsed sections after an expanded one are likely expanded next.
+   auto prefetch_count = 0UL;
+   for (auto index = 0UL; index < shown_count; ++index)
+   {
+      if (m_object->IsSectionExpanded(index))
+      {
+         PullContent(index);
+         prefetch_count = options.m_prefetch_count;
+      }
+      else if (prefetch_count > 0)
+      {
+         PullContent(index);
+         --prefetch_count;
+      }
+   }
+
+   // Expanded sections keep their content, the collapsed ones behind them are released instead.
+   const auto is_collapsed = [this](unsigned long index) { return !m_object->IsSectionExpanded(index); };
+   for (const auto index : m_data_source->GetExcessSections(is_collapsed))
+   {
+      m_object->GetSection(index).ReleaseContent();
+      m_data_source->ReleaseContent(index);
+   }
+
+   m_is_redraw = is_redraw;
+}
+
+void StickerModel::PullContent(unsigned long section_index)
+{
+   if (m_data_source->IsContentPulled(section_index))
+   {
+      m_data_source->TouchContent(section_index);
+      return;
+   }
+
+   auto& source = m_data_source->GetSource();
+   auto& section = m_object->GetSection(section_index);
+   // The first page of items, the rest is pulled by PullMoreItems.
+   const auto item_count = (std::min)(source.GetItemCount(section_index), m_data_source->GetOptions().m_item_page_size);
+
+   source.FillContent(section_index, section);
+   section.SetItemCount(item_count);
+   if (item_count > 0)
+   {
+      source.FillItems(section_index, 0, item_count, section);
+   }
+   m_data_source->TouchContent(section_index);
+   m_data_source->SetPulledItemCount(section_index, item_count);
+}
+
+/////////////// class Sticker /////////////////
+
+Sticker::Sticker() : wc::Window(), StickerModel(),
+   m_is_mouse_tracking(false),
+   m_is_live_resize(false),
+   m_input_recording(nullptr),
+   m_transition_timer(),
+   m_quality_tiers{ RenderQualityTier::GetDefault(RenderQuality::Fast), RenderQualityTier::GetDefault(RenderQuality::High) },
+   m_quality_policy(g_transition_frame_interval),
+   m_frame_quality(RenderQuality::High),
+   m_memory_image(),
+   m_is_frame_outdated(false),
+   m_cached_frame(),
+   m_is_frame_shown(false)
+{
+   StickerModel::SetAnimated(true);
+}
+
+Sticker::~Sticker()
+{
+   // no code
+}
+
+void Sticker::SetQualityTier(RenderQuality quality, const RenderQualityTier& tier)
+{
+   m_quality_tiers[static_cast<size_t>(quality)] = tier;
+   m_memory_image.reset();
+   ::InvalidateRect(GetHandle(), nullptr, FALSE);
+}
+
+void Sticker::SetFrameBudget(double frame_budget)
+{
+   m_quality_policy.SetFrameBudget(frame_budget);
+}
+
+void Sticker::SetInputRecording(InputRecording* recording)
+{
+   m_input_recording = recording;
+   if (m_input_recording)
+   {
+      const auto& collapsed_boundary = StickerModel::GetCollapsedBoundary();
+      m_input_recording->Start(static_cast<long>(collapsed_boundary.Width),
+                               static_cast<long>(collapsed_boundary.Height),
+                               InputStartState::Get(*this));
+   }
+}
+
 LRESULT Sticker::WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
    switch (uMsg)
@@ -108,29 +549,65 @@ LRESULT Sticker::WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
       {
          RECT client_rect;
          ::GetClientRect(GetHandle(), &client_rect);
-         m_object->Initialize(client_rect);
+         StickerModel::Initialize(client_rect);
          break;
       }
       case WM_LBUTTONUP:
       {
          OnLButtonUp(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         RecordInput(uMsg, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
          return TRUE;
       }
       case WM_MOUSEMOVE:
       {
          OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         RecordInput(uMsg, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
          return FALSE;
       }
       case WM_MOUSEHOVER:
       {
          OnMouseHover(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         RecordInput(uMsg, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
          return FALSE;
       }
       case WM_MOUSELEAVE:
       {
          OnMouseLeave();
+         RecordInput(uMsg, -1, -1);
          return FALSE;
       }
+      case WM_ENTERSIZEMOVE:
+      {
+         m_is_live_resize = true;
+         StickerModel::SetLiveResize(true);
+         break;
+      }
+      case WM_EXITSIZEMOVE:
+      {
+         m_is_live_resize = false;
+         StickerModel::SetLiveResize(false);
+         SettleQuality();
+         break;
+      }
+      case WM_SIZE:
+      {
+         OnSize(LOWORD(lParam));
+         break;
+      }
+      case WM_TIMER:
+      {
+         if (g_transition_timer_id == wParam)
+         {
+            OnTransitionFrame();
+            return 0;
+         }
+         if (g_idle_timer_id == wParam)
+         {
+            OnIdle();
+            return 0;
+         }
+         break;
+      }
       case WM_ERASEBKGND:
       {
          return TRUE;
@@ -139,7 +616,7 @@ LRESULT Sticker::WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
       {
          PAINTSTRUCT ps;
          HDC hdc = ::BeginPaint(GetHandle(), &ps);
-         OnPaint(hdc);
+         OnPaint(hdc, ps.rcPaint);
          ::EndPaint(GetHandle(), &ps);
          return 0;
       }
@@ -147,6 +624,19 @@ LRESULT Sticker::WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
    return Window::WindowProc(uMsg, wParam, lParam);
 }
 
+void Sticker::Invalidate()
+{
+   ::InvalidateRect(GetHandle(), nullptr, FALSE);
+}
+
+void Sticker::CollectMemoryUsage(BGO::MemoryUsage& usage) const
+{
+   StickerModel::CollectMemoryUsage(usage);
+   // Device copy of the frame has the same size in 32 bpp display modes.
+   const auto back_buffer_bytes = BGO::MemoryUsage::GetBitmapSize(m_memory_image.get());
+   usage.AddBackBuffer(m_cached_frame ? 2 * back_buffer_bytes : back_buffer_bytes);
+}
+
 void Sticker::OnLButtonUp(long x, long y)
 {
    if (!m_memory_image)
@@ -154,26 +644,29 @@ void Sticker::OnLButtonUp(long x, long y)
       return;
    }
 
-   if (m_object->ProcessClick(x, y) == BGO::Object::ClickType::ClickDoneNeedResize)
+   m_click_latency.Begin();
+
+   auto memory_graphics = GetGraphics(m_memory_image, GetQualityTier(RenderQuality::High));
+   if (StickerModel::ProcessClick(x, y, memory_graphics.get()))
    {
-      auto memory_graphics = GetGraphics(m_memory_image);
+      ResizeToContent();
+      m_click_latency.Mark(ClickStage::Resize);
       
-      m_object->RecalculateBoundary(0, 0, memory_graphics.get());
-      const auto& object_boundary = m_object->GetBoundary();
-
-      RECT window_rect;
-      ::GetWindowRect(GetHandle(), &window_rect);
-      ::MapWindowPoints(nullptr, ::GetParent(GetHandle()), (LPPOINT)(&window_rect), 2);
-
-      ::SetWindowPos(GetHandle(), nullptr,
-                     window_rect.left,
-                     window_rect.top,
-                     static_cast<int>(object_boundary.Width + 6.5),
-                     static_cast<int>(object_boundary.Height + 6.5),
-                     SWP_NOZORDER);
-      
-      m_is_dirty = true;
+      // Layout is already recalculated by the click, only the back buffer is redrawn.
+      // It's kept, unless the new size doesn't fit it.
+      m_is_frame_outdated = true;
       ::InvalidateRect(GetHandle(), nullptr, FALSE);
+
+      // The first frame of the transition is painted in full, as the window is resized.
+      if (StickerModel::IsTransitionActive())
+      {
+         m_transition_timer.Restart();
+         ::SetTimer(GetHandle(), g_transition_timer_id, g_transition_frame_interval, nullptr);
+      }
+   }
+   else
+   {
+      m_click_latency.Cancel();
    }
 }
 
@@ -205,8 +698,11 @@ void Sticker::OnMouseLeave()
    m_is_mouse_tracking = false;
 }
 
-void Sticker::OnPaint(HDC hdc)
+void Sticker::OnPaint(HDC hdc, const RECT& paint_rect)
 {
+   // Stages of a tracked click are marked, the other paints ignore them.
+   m_click_latency.Mark(ClickStage::Queue);
+
    RECT client_rect;
    ::GetClientRect(GetHandle(), &client_rect);
    
@@ -215,37 +711,151 @@ void Sticker::OnPaint(HDC hdc)
 
    Gdiplus::Graphics graphics(hdc);
 
-   if (m_is_dirty || !m_memory_image ||
-       client_width != m_memory_image->GetWidth() || client_height != m_memory_image->GetHeight())
+   // Back buffer only grows, so it isn't reallocated on every frame of live resize or on
+   // every expand and collapse. Only the client part of it is drawn and blitted.
+   const auto is_buffer_fit = m_memory_image &&
+      client_width <= static_cast<long>(m_memory_image->GetWidth()) &&
+      client_height <= static_cast<long>(m_memory_image->GetHeight());
+
+   // Frame of fast quality is rendered anew, when high quality becomes affordable.
+   const auto quality = m_quality_policy.GetQuality(IsInteractive());
+   const auto is_quality_raised = (RenderQuality::High == quality && RenderQuality::Fast == m_frame_quality);
+
+   if (m_is_dirty || m_is_frame_outdated || !is_buffer_fit || is_quality_raised)
    {
-      m_memory_image.reset(new Gdiplus::Bitmap(client_width, client_height, &graphics));
-      auto memory_graphics = GetGraphics(m_memory_image);
+      LatencyTimer frame_timer;
+      if (!is_buffer_fit)
+      {
+         m_memory_image.reset(new Gdiplus::Bitmap(client_width, client_height, &graphics));
+      }
+      auto memory_graphics = GetGraphics(m_memory_image, GetQualityTier(RenderQuality::High));
+
+      if (StickerModel::RecalculateIfDirty(memory_graphics.get()) && m_is_live_resize)
+      {
+         // Height of the sticker follows its content, while the width is dragged.
+         ResizeToContent(true);
+      }
+      GetQualityTier(quality).Apply(memory_graphics.get());
+      StickerModel::Draw(memory_graphics.get());
+      m_click_latency.Mark(ClickStage::Render);
+      m_is_frame_outdated = false;
+      OnFrameChanged();
+      m_frame_quality = quality;
+      m_quality_policy.AddFrame(quality, frame_timer.GetElapsed());
+
+      // Content might have changed, so the expanded layout is prepared anew, when updates calm down.
+      if (StickerModel::GetCollapsed() && !StickerModel::IsExpandedLayoutPrepared())
+      {
+         ::SetTimer(GetHandle(), g_idle_timer_id, g_idle_delay, nullptr);
+      }
+   }
 
-      if (m_is_dirty)
+   // Only the update region is blitted, e.g. the strips damaged by a transition frame.
+   const auto paint_width = static_cast<INT>(paint_rect.right - paint_rect.left);
+   const auto paint_height = static_cast<INT>(paint_rect.bottom - paint_rect.top);
+
+   // Frame, which is painted again unchanged (e.g. the window is uncovered), is blitted from
+   // its copy in the format of the device. The copy isn't made for frames painted only once.
+   if (m_is_frame_shown && !m_cached_frame)
+   {
+      m_cached_frame.reset(new Gdiplus::CachedBitmap(m_memory_image.get(), &graphics));
+   }
+   if (m_cached_frame)
+   {
+      graphics.SetClip(Gdiplus::Rect(static_cast<INT>(paint_rect.left), static_cast<INT>(paint_rect.top),
+                                     paint_width, paint_height));
+      if (graphics.DrawCachedBitmap(m_cached_frame.get(), 0, 0) != Gdiplus::Ok)
       {
-         m_object->RecalculateBoundary(0, 0, memory_graphics.get());
-         m_is_dirty = false;
+         // Copy is outdated by a change of the display mode, it is made anew on the next paint.
+         m_cached_frame.reset();
       }
+   }
+   if (!m_cached_frame)
+   {
+      graphics.DrawImage(m_memory_image.get(), static_cast<INT>(paint_rect.left), static_cast<INT>(paint_rect.top),
+                         static_cast<INT>(paint_rect.left), static_cast<INT>(paint_rect.top),
+                         paint_width, paint_height, Gdiplus::UnitPixel);
+   }
+   m_is_frame_shown = true;
+
+   m_click_latency.Mark(ClickStage::Blit);
+   m_click_latency.End();
+}
+
+void Sticker::OnSize(long width)
+{
+   if (m_is_live_resize && !StickerModel::GetCollapsed())
+   {
+      StickerModel::SetWidth(static_cast<unsigned long>(width));
+   }
+}
+
+void Sticker::OnTransitionFrame()
+{
+   std::vector<Gdiplus::RectF> damaged_rects;
+   const auto progress = m_transition_timer.GetElapsed() / g_transition_duration;
+   const auto is_finished = !StickerModel::AdvanceTransition(progress, damaged_rects);
+   if (is_finished)
+   {
+      ::KillTimer(GetHandle(), g_transition_timer_id);
+   }
+
+   if (!m_memory_image || m_is_dirty || m_is_frame_outdated)
+   {
+      // Full repaint is pending anyway, it draws the current frame.
+      return;
+   }
+
+   // Damaged strips are redrawn from the cached layers of the sections, which cross them.
+   LatencyTimer frame_timer;
+   const auto quality = m_quality_policy.GetQuality(true);
+   auto memory_graphics = GetGraphics(m_memory_image, GetQualityTier(quality));
+   for (const auto& rect : damaged_rects)
+   {
+      StickerModel::Draw(memory_graphics.get(), rect);
+      ::InvalidateRectF(GetHandle(), rect);
+   }
 
-      m_object->Draw(memory_graphics.get());
+   if (!damaged_rects.empty())
+   {
+      OnFrameChanged();
+      m_quality_policy.AddFrame(quality, frame_timer.GetElapsed());
+      if (RenderQuality::Fast == quality)
+      {
+         m_frame_quality = RenderQuality::Fast;
+      }
+   }
+   if (is_finished)
+   {
+      SettleQuality();
+   }
+}
+
+void Sticker::OnIdle()
+{
+   ::KillTimer(GetHandle(), g_idle_timer_id);
+   if (m_memory_image && !m_is_dirty)
+   {
+      auto memory_graphics = GetGraphics(m_memory_image, GetQualityTier(RenderQuality::High));
+      StickerModel::PrepareExpandedLayout(memory_graphics.get(), true);
    }
-            
-   graphics.DrawImage(m_memory_image.get(), 0, 0);
 }
 
 void Sticker::ProcessHover(long x, long y)
 {
-   if (!m_memory_image)
+   // Hovered objects would be redrawn at their final places, while they are sliding.
+   if (!m_memory_image || StickerModel::IsTransitionActive())
    {
       return;
    }
 
    BGO::TObjectPtrVector invalidated_objects;
-   m_object->ProcessHover(x, y, invalidated_objects);
+   StickerModel::ProcessHover(x, y, invalidated_objects);
 
    if (!invalidated_objects.empty())
    {
-      auto graphics = GetGraphics(m_memory_image);
+      // Patches match the rest of the frame.
+      auto graphics = GetGraphics(m_memory_image, GetQualityTier(m_frame_quality));
 
       Gdiplus::RectF invalidated_rect;
       for (auto index = 0UL; index < invalidated_objects.size(); ++index)
@@ -260,9 +870,561 @@ void Sticker::ProcessHover(long x, long y)
          {
             Gdiplus::RectF::Union(invalidated_rect, invalidated_rect, boundary);
          }
-         object->Draw(graphics.get());
+         StickerModel::DrawObject(graphics.get(), *object);
       }
+      OnFrameChanged();
 
       ::InvalidateRectF(GetHandle(), invalidated_rect);
    }
 }
+
+void Sticker::ResizeToContent(bool is_width_kept)
+{
+   const auto& object_boundary = StickerModel::GetBoundary();
+
+   RECT window_rect;
+   ::GetWindowRect(GetHandle(), &window_rect);
+   ::MapWindowPoints(nullptr, ::GetParent(GetHandle()), (LPPOINT)(&window_rect), 2);
+
+   // Frame depends on the window style, e.g. a sizing frame is wider than a dialog one.
+   RECT client_rect;
+   ::GetClientRect(GetHandle(), &client_rect);
+   const auto window_width = window_rect.right - window_rect.left;
+   const auto frame_width = window_width - (client_rect.right - client_rect.left);
+   const auto frame_height = (window_rect.bottom - window_rect.top) - (client_rect.bottom - client_rect.top);
+
+   ::SetWindowPos(GetHandle(), nullptr,
+                  window_rect.left,
+                  window_rect.top,
+                  is_width_kept ? window_width : static_cast<int>(object_boundary.Width + 0.5) + frame_width,
+                  static_cast<int>(object_boundary.Height + 0.5) + frame_height,
+                  SWP_NOZORDER);
+}
+
+void Sticker::RecordInput(UINT message, long x, long y)
+{
+   if (!m_input_recording)
+   {
+      return;
+   }
+
+   auto type = InputEvent::Type::MouseMove;
+   switch (message)
+   {
+      case WM_MOUSEHOVER: type = InputEvent::Type::MouseHover; break;
+      case WM_MOUSELEAVE: type = InputEvent::Type::MouseLeave; break;
+      case WM_LBUTTONUP:  type = InputEvent::Type::LButtonUp;  break;
+   }
+   m_input_recording->Add(type, x, y, StickerModel::GetCollapsed());
+}
+
+bool Sticker::IsInteractive() const
+{
+   return m_is_live_resize || StickerModel::IsTransitionActive();
+}
+
+const RenderQualityTier& Sticker::GetQualityTier(RenderQuality quality) const
+{
+   return m_quality_tiers[static_cast<size_t>(quality)];
+}
+
+void Sticker::SettleQuality()
+{
+   if (RenderQuality::Fast == m_frame_quality)
+   {
+      ::InvalidateRect(GetHandle(), nullptr, FALSE);
+   }
+}
+
+void Sticker::OnFrameChanged()
+{
+   m_cached_frame.reset();
+   m_is_frame_shown = false;
+}
+
+/////////////// class HeadlessSticker /////////////////
+
+HeadlessSticker::HeadlessSticker(long width, long height) : StickerModel(),
+   m_layout_image(new Gdiplus::Bitmap(1, 1, PixelFormat32bppARGB)),
+   m_memory_image(),
+   m_is_invalidated(true),
+   m_invalidation_count(0)
+{
+   const RECT boundary = { 0, 0, width, height };
+   StickerModel::Initialize(boundary);
+}
+
+HeadlessSticker::~HeadlessSticker()
+{
+   // no code
+}
+
+Gdiplus::Bitmap* HeadlessSticker::Render()
+{
+   {
+      auto layout_graphics = GetGraphics(m_layout_image);
+      StickerModel::RecalculateIfDirty(layout_graphics.get());
+   }
+
+   const auto& boundary = StickerModel::GetBoundary();
+   const auto width = (std::max)(1L, static_cast<long>(std::ceil(boundary.Width)));
+   const auto height = (std::max)(1L, static_cast<long>(std::ceil(boundary.Height)));
+
+   if (!m_memory_image || width != m_memory_image->GetWidth() || height != m_memory_image->GetHeight())
+   {
+      m_memory_image.reset(new Gdiplus::Bitmap(width, height, PixelFormat32bppARGB));
+   }
+
+   auto memory_graphics = GetGraphics(m_memory_image);
+   StickerModel::Draw(memory_graphics.get());
+   m_is_invalidated = false;
+
+   return m_memory_image.get();
+}
+
+bool HeadlessSticker::IsInvalidated() const
+{
+   return m_is_invalidated;
+}
+
+unsigned long HeadlessSticker::GetInvalidationCount() const
+{
+   return m_invalidation_count;
+}
+
+bool HeadlessSticker::Click(long x, long y)
+{
+   auto layout_graphics = GetGraphics(m_layout_image);
+   if (StickerModel::ProcessClick(x, y, layout_graphics.get()))
+   {
+      Render();
+      return true;
+   }
+   return false;
+}
+
+bool HeadlessSticker::Hover(long x, long y)
+{
+   if (!m_memory_image)
+   {
+      return false;
+   }
+
+   BGO::TObjectPtrVector invalidated_objects;
+   StickerModel::ProcessHover(x, y, invalidated_objects);
+
+   if (!invalidated_objects.empty())
+   {
+      auto graphics = GetGraphics(m_memory_image);
+      for (const auto object : invalidated_objects)
+      {
+         StickerModel::DrawObject(graphics.get(), *object);
+      }
+      return true;
+   }
+   return false;
+}
+
+void HeadlessSticker::PrepareExpanded()
+{
+   auto layout_graphics = GetGraphics(m_layout_image);
+   StickerModel::RecalculateIfDirty(layout_graphics.get());
+   StickerModel::PrepareExpandedLayout(layout_graphics.get(), true);
+}
+
+void HeadlessSticker::Invalidate()
+{
+   // The sticker is rendered on request only, just remember it is outdated.
+   m_is_invalidated = true;
+   ++m_invalidation_count;
+}
+
+void HeadlessSticker::CollectMemoryUsage(BGO::MemoryUsage& usage) const
+{
+   StickerModel::CollectMemoryUsage(usage);
+   usage.AddBackBuffer(BGO::MemoryUsage::GetBitmapSize(m_layout_image.get()) +
+                       BGO::MemoryUsage::GetBitmapSize(m_memory_image.get()));
+}
+
+/////////////// class StickerHost::HostedSticker /////////////////
+
+class StickerHost::HostedSticker : public StickerModel
+{
+public:
+   HostedSticker(StickerHost& host, long x, long y, long width, long height) :
+      StickerModel(), m_host(host), m_rect()
+   {
+      m_rect.left = x;
+      m_rect.top = y;
+      m_rect.right = x + width + 2 * g_hosted_frame_width;
+      m_rect.bottom = y + height + 2 * g_hosted_frame_width;
+
+      const RECT boundary = { 0, 0, width, height };
+      StickerModel::Initialize(boundary);
+   }
+
+   // Rectangle in the client area of the host, including the frame.
+   const RECT& GetRect() const
+   {
+      return m_rect;
+   }
+
+   // Returns true, if the size of the sticker has changed.
+   bool UpdateRect()
+   {
+      const auto& boundary = StickerModel::GetBoundary();
+      const auto right = m_rect.left + static_cast<LONG>(std::ceil(boundary.Width)) + 2 * g_hosted_frame_width;
+      const auto bottom = m_rect.top + static_cast<LONG>(std::ceil(boundary.Height)) + 2 * g_hosted_frame_width;
+      if (right != m_rect.right || bottom != m_rect.bottom)
+      {
+         m_rect.right = right;
+         m_rect.bottom = bottom;
+         return true;
+      }
+      return false;
+   }
+
+   long GetOriginX() const
+   {
+      return m_rect.left + g_hosted_frame_width;
+   }
+
+   long GetOriginY() const
+   {
+      return m_rect.top + g_hosted_frame_width;
+   }
+
+   using StickerModel::RecalculateIfDirty;
+   using StickerModel::Draw;
+   using StickerModel::ProcessClick;
+   using StickerModel::ProcessHover;
+
+protected:
+   // StickerModel overrides
+   virtual void Invalidate() override
+   {
+      // Layout is recalculated during the paint pass.
+      m_host.AddDamage(m_rect);
+   }
+
+private:
+   StickerHost& m_host;
+   RECT m_rect;
+};
+
+/////////////// class StickerHost /////////////////
+
+StickerHost::StickerHost() : wc::Window(),
+   m_stickers(),
+   m_memory_image(),
+   m_hit_test_cells(),
+   m_hit_test_columns(0),
+   m_is_hit_test_valid(false),
+   m_damaged_rect(),
+   m_hovered_sticker(nullptr),
+   m_is_mouse_tracking(false)
+{
+   // no code
+}
+
+StickerHost::~StickerHost()
+{
+   // no code
+}
+
+StickerModel& StickerHost::AddSticker(long x, long y, long width, long height)
+{
+   m_stickers.push_back(std::make_unique<HostedSticker>(*this, x, y, width, height));
+   m_is_hit_test_valid = false;
+   AddDamage(m_stickers.back()->GetRect());
+   return *m_stickers.back();
+}
+
+unsigned long StickerHost::GetStickerCount() const
+{
+   return m_stickers.size();
+}
+
+StickerModel& StickerHost::GetSticker(unsigned long index)
+{
+   return *m_stickers.at(index);
+}
+
+LRESULT StickerHost::WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+   switch (uMsg)
+   {
+      case WM_LBUTTONUP:
+      {
+         OnLButtonUp(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         return TRUE;
+      }
+      case WM_MOUSEMOVE:
+      {
+         OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         return FALSE;
+      }
+      case WM_MOUSEHOVER:
+      {
+         OnMouseHover(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+         return FALSE;
+      }
+      case WM_MOUSELEAVE:
+      {
+         OnMouseLeave();
+         return FALSE;
+      }
+      case WM_ERASEBKGND:
+      {
+         return TRUE;
+      }
+      case WM_PAINT:
+      {
+         PAINTSTRUCT ps;
+         HDC hdc = ::BeginPaint(GetHandle(), &ps);
+         OnPaint(hdc, ps.rcPaint);
+         ::EndPaint(GetHandle(), &ps);
+         return 0;
+      }
+   }
+   return Window::WindowProc(uMsg, wParam, lParam);
+}
+
+void StickerHost::OnLButtonUp(long x, long y)
+{
+   if (!m_memory_image)
+   {
+      return;
+   }
+
+   auto sticker = HitTest(x, y);
+   if (sticker != nullptr)
+   {
+      auto memory_graphics = GetGraphics(m_memory_image);
+      if (sticker->ProcessClick(x - sticker->GetOriginX(), y - sticker->GetOriginY(), memory_graphics.get()))
+      {
+         UpdateStickerRect(*sticker);
+      }
+   }
+}
+
+void StickerHost::OnMouseMove(long x, long y)
+{
+   if (!m_is_mouse_tracking)
+   {
+      TRACKMOUSEEVENT tracking_data;
+      tracking_data.cbSize = sizeof(tracking_data);
+      tracking_data.dwFlags = TME_HOVER | TME_LEAVE;
+      tracking_data.hwndTrack = GetHandle();
+      tracking_data.dwHoverTime = 1; 
+      
+      ::TrackMouseEvent(&tracking_data);
+      
+      m_is_mouse_tracking = true;
+   }
+}
+
+void StickerHost::OnMouseHover(long x, long y)
+{
+   ProcessHover(x, y);
+   m_is_mouse_tracking = false;
+}
+
+void StickerHost::OnMouseLeave()
+{
+   ProcessHover(-1, -1);
+   m_is_mouse_tracking = false;
+}
+
+void StickerHost::OnPaint(HDC hdc, const RECT& paint_rect)
+{
+   RECT client_rect;
+   ::GetClientRect(GetHandle(), &client_rect);
+   
+   const auto client_width = client_rect.right - client_rect.left;
+   const auto client_height = client_rect.bottom - client_rect.top;
+
+   Gdiplus::Graphics graphics(hdc);
+
+   if (!m_memory_image ||
+       client_width != m_memory_image->GetWidth() || client_height != m_memory_image->GetHeight())
+   {
+      m_memory_image.reset(new Gdiplus::Bitmap(client_width, client_height, &graphics));
+      m_is_hit_test_valid = false;
+      AddDamage(client_rect);
+   }
+
+   auto memory_graphics = GetGraphics(m_memory_image);
+
+   // Single pass: recalculate all dirty stickers, then redraw the damaged area at once.
+   for (auto& sticker : m_stickers)
+   {
+      if (sticker->RecalculateIfDirty(memory_graphics.get()))
+      {
+         UpdateStickerRect(*sticker);
+      }
+   }
+
+   if (::IsRectEmpty(&m_damaged_rect) == FALSE)
+   {
+      const Gdiplus::Rect damaged_rect(m_damaged_rect.left, m_damaged_rect.top,
+                                       m_damaged_rect.right - m_damaged_rect.left,
+                                       m_damaged_rect.bottom - m_damaged_rect.top);
+      memory_graphics->SetClip(damaged_rect);
+
+      Gdiplus::SolidBrush back_brush(g_host_back_color);
+      memory_graphics->FillRectangle(&back_brush, damaged_rect);
+
+      Gdiplus::Pen frame_pen(g_hosted_frame_color);
+      for (const auto& sticker : m_stickers)
+      {
+         RECT intersection;
+         if (::IntersectRect(&intersection, &sticker->GetRect(), &m_damaged_rect) != FALSE)
+         {
+            const auto& rect = sticker->GetRect();
+            memory_graphics->DrawRectangle(&frame_pen, Gdiplus::Rect(rect.left, rect.top,
+                                                                     rect.right - rect.left - 1,
+                                                                     rect.bottom - rect.top - 1));
+
+            memory_graphics->TranslateTransform(static_cast<Gdiplus::REAL>(sticker->GetOriginX()),
+                                                static_cast<Gdiplus::REAL>(sticker->GetOriginY()));
+            sticker->Draw(memory_graphics.get());
+            memory_graphics->ResetTransform();
+         }
+      }
+
+      // Part of the damaged area can be outside of the current update region
+      // (e.g. sticker has grown), so it is painted by the next WM_PAINT.
+      RECT outside_rect;
+      if (::SubtractRect(&outside_rect, &m_damaged_rect, &paint_rect) != FALSE)
+      {
+         ::InvalidateRect(GetHandle(), &m_damaged_rect, FALSE);
+      }
+      ::SetRectEmpty(&m_damaged_rect);
+   }
+
+   const auto paint_width = static_cast<INT>(paint_rect.right - paint_rect.left);
+   const auto paint_height = static_cast<INT>(paint_rect.bottom - paint_rect.top);
+   graphics.DrawImage(m_memory_image.get(), static_cast<INT>(paint_rect.left), static_cast<INT>(paint_rect.top),
+                      static_cast<INT>(paint_rect.left), static_cast<INT>(paint_rect.top),
+                      paint_width, paint_height, Gdiplus::UnitPixel);
+}
+
+void StickerHost::ProcessHover(long x, long y)
+{
+   if (!m_memory_image)
+   {
+      return;
+   }
+
+   const auto sticker = HitTest(x, y);
+
+   if (m_hovered_sticker != nullptr && m_hovered_sticker != sticker)
+   {
+      BGO::TObjectPtrVector invalidated_objects;
+      m_hovered_sticker->ProcessHover(-1, -1, invalidated_objects);
+      AddDamage(*m_hovered_sticker, invalidated_objects);
+   }
+
+   m_hovered_sticker = sticker;
+
+   if (sticker != nullptr)
+   {
+      BGO::TObjectPtrVector invalidated_objects;
+      sticker->ProcessHover(x - sticker->GetOriginX(), y - sticker->GetOriginY(), invalidated_objects);
+      AddDamage(*sticker, invalidated_objects);
+   }
+}
+
+void StickerHost::AddDamage(const RECT& rect)
+{
+   ::UnionRect(&m_damaged_rect, &m_damaged_rect, &rect);
+   if (GetHandle() != nullptr)
+   {
+      ::InvalidateRect(GetHandle(), &rect, FALSE);
+   }
+}
+
+void StickerHost::AddDamage(const HostedSticker& sticker, const BGO::TObjectPtrVector& invalidated_objects)
+{
+   for (const auto object : invalidated_objects)
+   {
+      const auto& boundary = object->GetBoundary();
+      const RECT rect =
+      {
+         static_cast<LONG>(boundary.X - 0.5) + sticker.GetOriginX(),
+         static_cast<LONG>(boundary.Y - 0.5) + sticker.GetOriginY(),
+         static_cast<LONG>(boundary.GetRight() + 0.5) + sticker.GetOriginX(),
+         static_cast<LONG>(boundary.GetBottom() + 0.5) + sticker.GetOriginY()
+      };
+      AddDamage(rect);
+   }
+}
+
+void StickerHost::UpdateStickerRect(HostedSticker& sticker)
+{
+   const auto old_rect = sticker.GetRect();
+   if (sticker.UpdateRect())
+   {
+      m_is_hit_test_valid = false;
+      AddDamage(old_rect);
+   }
+   AddDamage(sticker.GetRect());
+}
+
+StickerHost::HostedSticker* StickerHost::HitTest(long x, long y)
+{
+   if (x < 0 || y < 0)
+   {
+      return nullptr;
+   }
+
+   if (!m_is_hit_test_valid)
+   {
+      RECT client_rect;
+      ::GetClientRect(GetHandle(), &client_rect);
+
+      m_hit_test_columns = client_rect.right / g_hit_test_cell_size + 1;
+      const auto rows = client_rect.bottom / g_hit_test_cell_size + 1;
+
+      m_hit_test_cells.assign(m_hit_test_columns * rows, std::vector<unsigned long>());
+      for (auto index = 0UL; index < m_stickers.size(); ++index)
+      {
+         const auto& rect = m_stickers[index]->GetRect();
+         const auto first_column = (std::max)(0L, rect.left) / g_hit_test_cell_size;
+         const auto last_column = (std::min)(static_cast<long>(m_hit_test_columns) - 1,
+                                           (rect.right - 1) / g_hit_test_cell_size);
+         const auto first_row = (std::max)(0L, rect.top) / g_hit_test_cell_size;
+         const auto last_row = (std::min)(static_cast<long>(rows) - 1, (rect.bottom - 1) / g_hit_test_cell_size);
+
+         for (auto row = first_row; row <= last_row; ++row)
+         {
+            for (auto column = first_column; column <= last_column; ++column)
+            {
+               m_hit_test_cells[row * m_hit_test_columns + column].push_back(index);
+            }
+         }
+      }
+      m_is_hit_test_valid = true;
+   }
+
+   const auto column = x / g_hit_test_cell_size;
+   const auto cell_index = (y / g_hit_test_cell_size) * m_hit_test_columns + column;
+   if (static_cast<unsigned long>(column) >= m_hit_test_columns || cell_index >= m_hit_test_cells.size())
+   {
+      return nullptr;
+   }
+
+   // The topmost sticker is the last drawn one.
+   const auto& cell = m_hit_test_cells[cell_index];
+   const POINT point = { x, y };
+   for (auto iter = cell.rbegin(); iter != cell.rend(); ++iter)
+   {
+      auto& sticker = m_stickers[*iter];
+      if (::PtInRect(&sticker->GetRect(), point) != FALSE)
+      {
+         return sticker.get();
+      }
+   }
+   return nullptr;
+}
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "window.h"
+#include "memory_usage.h"
+#include "latency_statistics.h"
+#include "render_quality.h"
+#include "data_source.h"
 
 #include <gdiplus.h>
 
 #include <vector>
 #include <memory>
+#include <iosfwd>
 
 enum class ImageType { None, Ok, Expired, Minus, Arrow };
 enum class ColorType { Green, Red, Grey };
@@ -35,46 +40,286 @@ public:
    virtual void OnFooterClick(unsigned long section_index) = 0;
 };
 
+namespace BGO
+{
+   class Object;
+   class DisplayList;
+}
+
 namespace SGO
 {
    // Forward declaration to use in PIMPL.
    class StickerObject;
 }
 
-class Sticker : public wc::Window
+class InputRecording;
+
+// Content of a sticker, independent from the place it is shown in: the object
+// tree, its dirty state and the callback. Derived classes define how the content
+// is invalidated and painted (own window in Sticker, shared window in StickerHost).
+class StickerModel
 {
+   StickerModel(const StickerModel& rhs) = delete;
+   StickerModel& operator=(const StickerModel& rhs) = delete;
+
 public:
-   Sticker();
-   ~Sticker();
+   StickerModel();
+   virtual ~StickerModel();
 
    void SetDirty();
    void SetRedraw(bool is_redraw);
    void Update();
 
    void SetSectionCount(unsigned long count);
+   unsigned long GetSectionCount() const;
    ISection& GetSection(unsigned long index);
+   // Sections above "More", the collapsed sticker shows only the title of the first one.
+   unsigned long GetShownSectionCount() const;
+   bool IsSectionExpanded(unsigned long index) const;
    
+   // Callback is called synchronously in the click, CallbackDispatcher moves it off the UI thread.
    void SetCallback(std::unique_ptr<IStickerCallback>&& callback);
    IStickerCallback* GetCallback() const;
 
+   // Optional source of the content. Before a layout the sticker pulls from it what the layout
+   // shows, instead of having everything pushed through GetSection. Null pointer turns it off,
+   // pulled content stays.
+   void SetDataSource(std::unique_ptr<IStickerDataSource>&& source,
+                      const DataSourceOptions& options = DataSourceOptions());
+   // Pulls the section count anew and everything shown, e.g. the history has changed.
+   // The sticker keeps a slot per section of the source (a pointer and the layout data),
+   // sections themselves are created, when their titles are pulled.
+   void ReloadDataSource();
+   // Items are pulled by pages. Returns true, if the source has items of the section
+   // beyond the pulled ones, e.g. to offer them in the footer.
+   bool HasMoreItems(unsigned long section_index) const;
+   // Pulls the next page of items of the section, whose content is pulled, e.g. on
+   // a click of its footer. Returns false, if there is nothing to pull.
+   bool PullMoreItems(unsigned long section_index);
+
+   // Collapsed sticker shows only the title of the first section.
+   void SetCollapsed(bool is_collapsed);
+   bool GetCollapsed() const;
+
+   // Width of the expanded sticker, the collapsed one keeps its initial size.
+   void SetWidth(unsigned long width);
+   unsigned long GetWidth() const;
+   // Live resize is a series of SetWidth calls, e.g. a drag of the window frame.
+   // Meanwhile sections are drawn without caching their layers.
+   void SetLiveResize(bool is_live_resize);
+
+   // Animated sticker slides its sections to the new places after a click, otherwise
+   // the new layout is shown at once. Frames are driven by the derived class.
+   void SetAnimated(bool is_animated);
+
+   // In display-list mode the tree is recorded into drawing commands after a relayout,
+   // frames replay them and hovered objects re-record only their own commands.
+   void SetDisplayListMode(bool is_enabled);
+   // Dumps drawing commands of the current layout, e.g. to compare frames while debugging.
+   void SaveDisplayList(std::ostream& stream) const;
+
+   // Memory, used by the object tree, its caches and the back buffer.
+   BGO::MemoryUsage GetMemoryUsage() const;
+
+   // Latency of clicks, which change the layout. Tracked by Sticker, which knows
+   // when the frame is on the screen, the budget is set by the host.
+   ClickLatency& GetClickLatency();
+   const ClickLatency& GetClickLatency() const;
+
+protected:
+   // Own virtual method. Called, when the content requires repainting.
+   virtual void Invalidate() = 0;
+   // Own virtual method. Adds memory of the derived class, e.g. its back buffer.
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const;
+
+   void Initialize(const RECT& boundary);
+   const Gdiplus::RectF& GetBoundary() const;
+   const Gdiplus::RectF& GetCollapsedBoundary() const;
+
+   // Recalculates layout, if the content is dirty. Returns true, if it was done.
+   bool RecalculateIfDirty(Gdiplus::Graphics* graphics);
+   void Draw(Gdiplus::Graphics* graphics) const;
+   // Draws only the objects crossing the rect, e.g. a strip damaged by a transition frame.
+   // Graphics is clipped to the rect meanwhile.
+   void Draw(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const;
+   // Draws one object of the tree, e.g. the one invalidated by hovering.
+   void DrawObject(Gdiplus::Graphics* graphics, const BGO::Object& object) const;
+   // See StickerObject::PrepareExpandedLayout.
+   void PrepareExpandedLayout(Gdiplus::Graphics* graphics, bool is_rendered);
+   bool IsExpandedLayoutPrepared() const;
+
+   // Returns true, if click changed the layout (it is already recalculated).
+   // Animated sticker starts a transition then.
+   bool ProcessClick(long x, long y, Gdiplus::Graphics* graphics);
+   void ProcessHover(long x, long y, std::vector<BGO::Object*>& invalidated_objects);
+
+   bool IsTransitionActive() const;
+   // Progress is in [0, 1]. Adds the areas to redraw, returns false when finished.
+   bool AdvanceTransition(double progress, std::vector<Gdiplus::RectF>& damaged_rects);
+
+private:
+   // Pulls titles of the shown sections and content of the expanded ones, prefetches
+   // the neighbouring ones and releases content beyond the cache. Called before layout.
+   void PullDataSource();
+   void PullContent(unsigned long section_index);
+   // Records the display list anew, if the tree has changed since the last recording.
+   void RecordIfInvalid() const;
+
+protected:
+   bool m_is_dirty;
+   bool m_is_redraw;
+   bool m_is_animated;
+   ClickLatency m_click_latency;
+
+   std::unique_ptr<IStickerCallback> m_callback;
+   std::unique_ptr<SGO::StickerObject> m_object;
+   std::unique_ptr<DataSourceCache> m_data_source;
+
+   // Exists in display-list mode only, it is recorded anew on the next Draw, when invalid.
+   std::unique_ptr<BGO::DisplayList> m_display_list;
+   mutable bool m_is_display_list_valid;
+};
+
+class Sticker : public wc::Window, public StickerModel
+{
+public:
+   Sticker();
+   ~Sticker();
+
+   // Starts recording of the mouse input into the given recording, which must
+   // outlive the recording. Null pointer stops the recording.
+   void SetInputRecording(InputRecording* recording);
+
+   // Frames during resize and animation may be rendered in fast quality to fit the budget
+   // (milliseconds), the settled sticker is rendered again in high quality.
+   void SetQualityTier(RenderQuality quality, const RenderQualityTier& tier);
+   void SetFrameBudget(double frame_budget);
+
 protected:
    virtual LRESULT WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam) override;
+   // StickerModel overrides
+   virtual void Invalidate() override;
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const override;
    
 private:
    void OnLButtonUp(long x, long y);
    void OnMouseMove(long x, long y);
    void OnMouseHover(long x, long y);
    void OnMouseLeave();
-   void OnPaint(HDC hdc);
+   void OnPaint(HDC hdc, const RECT& paint_rect);
+   void OnSize(long width);
+   void OnTransitionFrame();
+   void OnIdle();
    
    void ProcessHover(long x, long y);
+   // Window keeps its width, while the user drags its frame, only the height follows the content.
+   void ResizeToContent(bool is_width_kept = false);
+   void RecordInput(UINT message, long x, long y);
+
+   // Resize and animation are interactive, their frames are replaced soon.
+   bool IsInteractive() const;
+   const RenderQualityTier& GetQualityTier(RenderQuality quality) const;
+   // Repaints the sticker in high quality, if the shown frame is rendered in fast one.
+   void SettleQuality();
+   // Called after drawing into the back buffer.
+   void OnFrameChanged();
 
 private:
-   bool m_is_dirty;
-   bool m_is_redraw;
    bool m_is_mouse_tracking;
+   bool m_is_live_resize;
+   InputRecording* m_input_recording;
+   LatencyTimer m_transition_timer;
+
+   RenderQualityTier m_quality_tiers[2];
+   RenderQualityPolicy m_quality_policy;
+   RenderQuality m_frame_quality;   // Quality of the back buffer, the lowest of its parts
    
    std::unique_ptr<Gdiplus::Bitmap> m_memory_image;
-   std::unique_ptr<IStickerCallback> m_callback;
-   std::unique_ptr<SGO::StickerObject> m_object;
+   bool m_is_frame_outdated;   // Back buffer is redrawn in full on the next paint
+   // Copy of the back buffer in the format of the display, made once the frame is painted twice.
+   std::unique_ptr<Gdiplus::CachedBitmap> m_cached_frame;
+   bool m_is_frame_shown;
+};
+
+// Sticker without any window and message loop. It renders into its own bitmap
+// on request, e.g. to make snapshots of stickers in background threads.
+class HeadlessSticker : public StickerModel
+{
+public:
+   // Width and height define the size of the collapsed sticker.
+   HeadlessSticker(long width, long height);
+   ~HeadlessSticker();
+
+   // Recalculates layout, if required, and renders the whole sticker.
+   Gdiplus::Bitmap* Render();
+   // Returns true, if the content has changed since the last rendering.
+   bool IsInvalidated() const;
+   // Grows on each change of the content, also after it's already invalidated.
+   unsigned long GetInvalidationCount() const;
+
+   // Mouse input in sticker coordinates, as it comes to the window of Sticker.
+   // Both return true, if the rendered image has been changed.
+   bool Click(long x, long y);
+   bool Hover(long x, long y);
+
+   // Lays out and renders the expanded sticker in advance, while it is collapsed.
+   void PrepareExpanded();
+
+protected:
+   // StickerModel overrides
+   virtual void Invalidate() override;
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const override;
+
+private:
+   // Tiny bitmap, providing graphics for layout before the size is known.
+   std::unique_ptr<Gdiplus::Bitmap> m_layout_image;
+   std::unique_ptr<Gdiplus::Bitmap> m_memory_image;
+   bool m_is_invalidated;
+   unsigned long m_invalidation_count;
+};
+
+// Window, which shows many stickers as its windowless children. All stickers share
+// one back buffer and one hit-test index, and are painted in a single WM_PAINT pass.
+class StickerHost : public wc::Window
+{
+public:
+   StickerHost();
+   ~StickerHost();
+
+   // Adds sticker with the collapsed size (width, height) at (x, y) of the client area.
+   StickerModel& AddSticker(long x, long y, long width, long height);
+   unsigned long GetStickerCount() const;
+   StickerModel& GetSticker(unsigned long index);
+
+protected:
+   virtual LRESULT WindowProc(UINT uMsg, WPARAM wParam, LPARAM lParam) override;
+
+private:
+   class HostedSticker;
+
+   void OnLButtonUp(long x, long y);
+   void OnMouseMove(long x, long y);
+   void OnMouseHover(long x, long y);
+   void OnMouseLeave();
+   void OnPaint(HDC hdc, const RECT& paint_rect);
+
+   void ProcessHover(long x, long y);
+   void AddDamage(const RECT& rect);
+   void AddDamage(const HostedSticker& sticker, const std::vector<BGO::Object*>& invalidated_objects);
+   void UpdateStickerRect(HostedSticker& sticker);
+   HostedSticker* HitTest(long x, long y);
+
+private:
+   std::vector<std::unique_ptr<HostedSticker>> m_stickers;
+   std::unique_ptr<Gdiplus::Bitmap> m_memory_image;
+
+   // Uniform grid over the client area. Each cell lists indexes
+   // of the stickers intersecting it, in the drawing order.
+   std::vector<std::vector<unsigned long>> m_hit_test_cells;
+   unsigned long m_hit_test_columns;
+   bool m_is_hit_test_valid;
+
+   RECT m_damaged_rect;
+   HostedSticker* m_hovered_sticker;
+   bool m_is_mouse_tracking;
 };
@@ -1,7 +1,14 @@
 #include "sticker_objects.h"
+#include "resource_manager.h"
+#include "display_list.h"
 
 #include <sstream>
 #include <cassert>
+#include <cstring>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <initializer_list>
 
 // Sticker graphic objects namespace
 namespace SGO
@@ -13,16 +20,21 @@ namespace
 ////////////////// Constants //////////////////
 
 const wchar_t g_tahoma_name[] = L"Tahoma";
-const auto g_indent_vert = 3UL;
-const auto g_indent_horz = 3UL;
+const auto g_image_size = 10UL;
 const auto g_shorted_section_amount = 2UL;
 
-const auto g_section_width = 300UL;
-const auto g_header_descr_width = g_section_width - 10 - g_indent_horz;
+const auto g_default_section_width = 300UL;
+const auto g_min_section_width = 150UL;
 const auto g_item_date_width = 36UL;
 const auto g_item_time_width = 34UL;
 const auto g_footer_prefix_width = g_item_date_width + g_item_time_width + g_indent_horz;
 
+// Header description takes the section width without the header image.
+inline unsigned long GetHeaderDescriptionWidth(unsigned long section_width)
+{
+   return section_width - g_image_size - g_indent_horz;
+}
+
 namespace Colors
 {
    const Gdiplus::Color black(0x00, 0x00, 0x00);
@@ -50,8 +62,112 @@ namespace Colors
    }
 }
 
+/////////////////// Raw content ///////////////////
+
+// Joins strings into one buffer, each one terminated by zero. Null strings are stored as empty.
+std::string PackStrings(std::initializer_list<const char*> texts)
+{
+   std::string packed;
+   for (const auto text : texts)
+   {
+      if (text != nullptr)
+      {
+         packed.append(text);
+      }
+      packed.push_back('\0');
+   }
+   packed.shrink_to_fit();
+   return packed;
+}
+
+// Returns the string following the given one in the packed buffer.
+inline const char* NextPackedString(const char* text)
+{
+   return text + std::strlen(text) + 1;
+}
+
+/////////////////// Images ///////////////////
+
+// Fills the cell of the atlas, corresponding to the image type.
+void DrawImageType(ImageType image, Gdiplus::Graphics* graphics)
+{
+   graphics->SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+   const Gdiplus::REAL size = g_image_size;
+
+   switch (image)
+   {
+      case ImageType::Ok:
+      {
+         const Gdiplus::PointF points[] = { {1, size / 2}, {size * 2 / 5, size - 2}, {size - 1, 2} };
+         Gdiplus::Pen pen(Colors::green_dark, 2);
+         graphics->DrawLines(&pen, points, sizeof(points) / sizeof(points[0]));
+         break;
+      }
+      case ImageType::Expired:
+      {
+         Gdiplus::Pen pen(Colors::red_dark, 1);
+         graphics->DrawEllipse(&pen, Gdiplus::RectF(0.5, 0.5, size - 1, size - 1));
+         graphics->DrawLine(&pen, size / 2, 2, size / 2, size / 2);
+         graphics->DrawLine(&pen, size / 2, size / 2, size - 3, size / 2);
+         break;
+      }
+      case ImageType::Minus:
+      {
+         Gdiplus::SolidBrush brush(Colors::grey_dark);
+         graphics->FillRectangle(&brush, Gdiplus::RectF(1, size / 2 - 1, size - 2, 2));
+         break;
+      }
+      case ImageType::Arrow:
+      {
+         const Gdiplus::PointF points[] = { {2, 1}, {size - 2, size / 2}, {2, size - 1} };
+         Gdiplus::SolidBrush brush(Colors::blue_dark);
+         graphics->FillPolygon(&brush, points, sizeof(points) / sizeof(points[0]));
+         break;
+      }
+      default:
+      {
+         assert(!"Unknown image");
+      }
+   }
+}
+
+// All image types are rasterized into the single atlas, shared by all images of all stickers of
+// a thread. It's built by the first image of the thread, not at startup: GDI+ bitmaps can't be
+// used by several threads, and an atlas alive till the exit would outlive GdiplusShutdown.
+std::shared_ptr<const BGO::ImageAtlas> GetImageAtlas()
+{
+   return BGO::ResourceManager::GetInstance().GetImageAtlas(L"ImageType", []()
+   {
+      const ImageType images[] = { ImageType::Ok, ImageType::Expired, ImageType::Minus, ImageType::Arrow };
+      const auto image_count = sizeof(images) / sizeof(images[0]);
+
+      auto atlas = new BGO::ImageAtlas(g_image_size, g_image_size, image_count);
+      for (auto index = 0UL; index < image_count; ++index)
+      {
+         DrawImageType(images[index], atlas->GetImageGraphics(index).get());
+      }
+      return atlas;
+   });
+}
+
+// Index of the image in the atlas, see GetImageAtlas.
+inline long ImageTypeToIndex(ImageType image)
+{
+   return (ImageType::None == image) ? BGO::Image::NoImage : static_cast<long>(image) - 1;
+}
+
 } // namespace
 
+/////////// class ItemImage //////////
+
+ItemImage::ItemImage() : BGO::Image(GetImageAtlas())
+{}
+
+bool ItemImage::SetImage(ImageType image)
+{
+   return BGO::Image::SetIndex(ImageTypeToIndex(image));
+}
+
 /////////// class ItemDate //////////
 
 ItemDate::ItemDate() :
@@ -73,96 +189,86 @@ ItemDescription::ItemDescription() :
 
 /////////// class SectionItem //////////
 
-SectionItem::SectionItem() : Group(GroupType::Horizontal)
-{
-   Group::SetObjectCount(idxLast);
-   Group::SetObject(idxImage, std::make_unique<BGO::Image>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDate, std::make_unique<ItemDate>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxTime, std::make_unique<ItemTime>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDesc, std::make_unique<ItemDescription>(), AligningType::Max, g_indent_horz);
-}
-
 bool SectionItem::SetImage(ImageType image)
 {
-   //return static_cast<BGO::Image*>(Group::GetObject(idxImage))->SetImage(image);
+   return GetObject<idxImage>().SetImage(image);
 }
 
 bool SectionItem::SetDate(const char* text)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxDate))->SetText(text);
+   return GetObject<idxDate>().SetText(text);
 }
 
 bool SectionItem::SetTime(const char* text)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxTime))->SetText(text);
+   return GetObject<idxTime>().SetText(text);
 }
 
 bool SectionItem::SetDescription(const char* text)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxDesc))->SetText(text);
+   return GetObject<idxDesc>().SetText(text);
 }
 
 bool SectionItem::SetClickable(bool is_clickable)
 {
-   return static_cast<BGO::ClickableText*>(Group::GetObject(idxDesc))->SetClickable(is_clickable);
+   return GetObject<idxDesc>().SetClickable(is_clickable);
 }
 
 ////////// class HeaderDescriptionText ////////
 
 HeaderDescriptionText::HeaderDescriptionText() : 
-   Text(Colors::grey_very_light, g_tahoma_name, 9, Gdiplus::FontStyleRegular, Colors::grey_dark, g_header_descr_width)
+   WrappedText(Colors::grey_very_light, g_tahoma_name, 9, Gdiplus::FontStyleRegular, Colors::grey_dark,
+               GetHeaderDescriptionWidth(g_default_section_width))
 {}
 
 /////// class HeaderDescriptionClickabeText ///////
 
 HeaderDescriptionClickabeText::HeaderDescriptionClickabeText() : 
    ClickableText(Colors::grey_very_light, g_tahoma_name, 9, Gdiplus::FontStyleRegular,
-                 Colors::grey_dark, g_header_descr_width, Colors::blue_dark)
+                 Colors::grey_dark, GetHeaderDescriptionWidth(g_default_section_width), Colors::blue_dark)
 {
    SetClickable(true);
 }
 
 ////////// class HeaderDescription //////////
 
-HeaderDescription::HeaderDescription() : Group(GroupType::Vertical)
-{
-   Group::SetObjectCount(idxLast);
-   Group::SetObject(idxText, std::make_unique<HeaderDescriptionText>(), AligningType::Max, g_indent_vert);
-   Group::SetObject(idxClkText, std::make_unique<HeaderDescriptionClickabeText>(), AligningType::Max, 0);
-}
-
 bool HeaderDescription::SetText(const char* text)
 {
-   return static_cast<HeaderDescriptionText*>(Group::GetObject(idxText))->SetText(text);
+   return GetObject<idxText>().SetText(text);
 }
 
 bool HeaderDescription::SetClickableText(const char* text)
 {
-   return static_cast<HeaderDescriptionClickabeText*>(Group::GetObject(idxClkText))->SetText(text);
+   return GetObject<idxClkText>().SetText(text);
 }
 
-/////////// class SectionHeader //////////
-
-SectionHeader::SectionHeader() : Group(GroupType::Horizontal)
+bool HeaderDescription::SetWidth(unsigned long width)
 {
-   Group::SetObjectCount(idxLast);
-   Group::SetObject(idxImage, std::make_unique<BGO::Image>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDesc, std::make_unique<HeaderDescription>(), AligningType::Max, g_indent_horz);
+   auto is_changed = GetObject<idxText>().SetWidth(width);
+   is_changed |= GetObject<idxClkText>().SetWidth(width);
+   return is_changed;
 }
 
+/////////// class SectionHeader //////////
+
 bool SectionHeader::SetImage(ImageType image)
 {
-   //return static_cast<BGO::Image*>(Group::GetObject(idxImage))->SetImage();
+   return GetObject<idxImage>().SetImage(image);
 }
 
 bool SectionHeader::SetText(const char* text)
 {
-   return static_cast<HeaderDescription*>(Group::GetObject(idxDesc))->SetText(text);
+   return GetObject<idxDesc>().SetText(text);
 }
 
 bool SectionHeader::SetClickableText(const char* text)
 {
-   return static_cast<HeaderDescription*>(Group::GetObject(idxDesc))->SetClickableText(text);
+   return GetObject<idxDesc>().SetClickableText(text);
+}
+
+bool SectionHeader::SetWidth(unsigned long section_width)
+{
+   return GetObject<idxDesc>().SetWidth(GetHeaderDescriptionWidth(section_width));
 }
 
 /////////// class FooterPrefix //////////
@@ -180,37 +286,29 @@ FooterDescription::FooterDescription() :
 
 ///////////// class SectionFooter ////////////////
 
-SectionFooter::SectionFooter() : Group(GroupType::Horizontal)
-{
-   Group::SetObjectCount(idxLast);
-   Group::SetObject(idxImage, std::make_unique<BGO::Image>(), Group::AligningType::Max, g_indent_horz);
-   Group::SetObject(idxPrefix, std::make_unique<FooterPrefix>(), Group::AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDesc, std::make_unique<FooterDescription>(), Group::AligningType::Max, g_indent_horz);
-}
-
 bool SectionFooter::SetImage(ImageType image)
 {
-   //return static_cast<BGO::Image*>(Group::GetObject(idxImage))->SetImage();
+   return GetObject<idxImage>().SetImage(image);
 }
 
 bool SectionFooter::SetPrefix(const char* text)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxPrefix))->SetText(text);
+   return GetObject<idxPrefix>().SetText(text);
 }
 
 bool SectionFooter::SetDescription(const char* text)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxDesc))->SetText(text);
+   return GetObject<idxDesc>().SetText(text);
 }
 
 bool SectionFooter::SetColor(ColorType color)
 {
-   return static_cast<BGO::Text*>(Group::GetObject(idxPrefix))->SetColor(Colors::ColorTypeToColor(color));
+   return GetObject<idxPrefix>().SetColor(Colors::ColorTypeToColor(color));
 }
 
 bool SectionFooter::SetClickable(bool is_clickable)
 {
-   return static_cast<BGO::ClickableText*>(Group::GetObject(idxDesc))->SetClickable(is_clickable);
+   return GetObject<idxDesc>().SetClickable(is_clickable);
 }
 
 ///////// class TitleDesctiption //////////
@@ -222,48 +320,39 @@ TitleDescription ::TitleDescription() :
 
 /////////// class SectionTitle ////////////
 
-SectionTitle::SectionTitle() : Group(GroupType::Horizontal)
-{
-   Group::SetObjectCount(idxLast);
-   Group::SetObject(idxImage, std::make_unique<BGO::Image>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDate, std::make_unique<ItemDate>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxTime, std::make_unique<ItemTime>(), AligningType::Max, g_indent_horz);
-   Group::SetObject(idxDesc, std::make_unique<TitleDescription>(), AligningType::Max, g_indent_horz);
-}
-
 bool SectionTitle::SetImage(ImageType image)
 {
-   //return static_cast<BGO::Image*>(Group::GetObject(idxImage))->SetImage(image);
+   return GetObject<idxImage>().SetImage(image);
 }
 
 bool SectionTitle::SetDate(const char* text)
 {
-   return static_cast<ItemDate*>(Group::GetObject(idxDate))->SetText(text);
+   return GetObject<idxDate>().SetText(text);
 }
 
 bool SectionTitle::SetTime(const char* text)
 {
-   return static_cast<ItemTime*>(Group::GetObject(idxTime))->SetText(text);
+   return GetObject<idxTime>().SetText(text);
 }
 
 bool SectionTitle::SetDescription(const char* text)
 {
-   return static_cast<TitleDescription*>(Group::GetObject(idxDesc))->SetText(text);
+   return GetObject<idxDesc>().SetText(text);
 }
 
 bool SectionTitle::SetColor(ColorType color)
 {
-   return static_cast<TitleDescription*>(Group::GetObject(idxDesc))->SetColor(Colors::ColorTypeToColor(color));
+   return GetObject<idxDesc>().SetColor(Colors::ColorTypeToColor(color));
 }
 
 const TitleDescription& SectionTitle::GetDescription() const
 {
-   return *static_cast<const TitleDescription*>(Group::GetObject(idxDesc));
+   return GetObject<idxDesc>();
 }
 
 TitleDescription& SectionTitle::GetDescription()
 {
-   return *static_cast<TitleDescription*>(Group::GetObject(idxDesc));
+   return GetObject<idxDesc>();
 }
 
 bool SectionTitle::IsObjectVisible(unsigned long index) const
@@ -273,7 +362,7 @@ bool SectionTitle::IsObjectVisible(unsigned long index) const
 
 /////////// class SectionLine /////////////
 
-SectionLine::SectionLine() : BGO::Line(Colors::grey_very_light, Colors::grey_dark, g_section_width)
+SectionLine::SectionLine() : BGO::Line(Colors::grey_very_light, Colors::grey_dark, g_default_section_width)
 {}
 
 ///////////// class OwnerName /////////////
@@ -283,16 +372,44 @@ OwnerName::OwnerName() : BGO::Text(Colors::grey_very_light, g_tahoma_name, 9, Gd
 
 ///////////// class Section ////////////////
 
-Section::Section(Sticker& sticker) : 
-   Group(GroupType::Vertical), m_sticker(sticker), m_owner_name()
+// Strings of the raw content are packed into one buffer, separated by zeros.
+struct Section::RawContent
+{
+   struct Item
+   {
+      std::string m_texts;   // Date, time, description
+      ImageType m_image;
+      bool m_is_clickable;
+      bool m_is_set;
+   };
+   // Collapsed sections may hold long histories, so a stored item is just its packed texts and flags.
+   static_assert(sizeof(Item) <= sizeof(std::string) + sizeof(void*), "Raw item keeps more than its texts");
+
+   std::string m_header_texts;   // Text, clickable text
+   ImageType m_header_image;
+   bool m_has_header;
+
+   std::string m_footer_texts;   // Prefix, description
+   ImageType m_footer_image;
+   ColorType m_footer_color;
+   bool m_is_footer_clickable;
+   bool m_has_footer;
+
+   std::vector<Item> m_items;
+};
+
+Section::Section(StickerModel& sticker) : 
+   LayeredGroup(GroupType::Vertical), m_sticker(sticker), m_owner_name(), m_raw_content(),
+   m_width(g_default_section_width)
 {
    Group::SetObjectCount(idxLast);
-   Group::SetObject(idxLineBefore, std::make_unique<SectionLine>(), AligningType::Min, g_indent_vert);
    Group::SetObject(idxTitle, std::make_unique<SectionTitle>(), AligningType::Min, g_indent_vert);
-   Group::SetObject(idxHeader, std::make_unique<SectionHeader>(), AligningType::Min, g_indent_vert);
-   Group::SetObject(idxItems, std::make_unique<Group>(GroupType::Vertical), AligningType::Min, g_indent_vert);
-   Group::SetObject(idxFooter, std::make_unique<SectionFooter>(), AligningType::Min, g_indent_vert);
-   Group::SetObject(idxLineAfter, std::make_unique<SectionLine>(), AligningType::Min, g_indent_vert);
+   ResetContent();
+}
+
+Section::~Section()
+{
+   // no code
 }
 
 const SectionTitle& Section::GetTitle() const
@@ -305,11 +422,38 @@ SectionTitle& Section::GetTitle()
    return *static_cast<SectionTitle*>(Group::GetObject(idxTitle));
 }
 
+void Section::SetWidth(unsigned long width)
+{
+   if (m_width != width)
+   {
+      m_width = width;
+      if (IsMaterialized() && !GetTitle().GetDescription().GetCollapsed())
+      {
+         SetDirty();
+      }
+   }
+}
+
+void Section::SetLiveResize(bool is_live_resize)
+{
+   // Layer of the resized section would be re-rendered on every frame anyway.
+   LayeredGroup::SetLayerCaching(!is_live_resize);
+}
+
+void Section::ReleaseContent()
+{
+   assert(GetTitle().GetDescription().GetCollapsed());
+
+   // Content isn't shown, so neither the layout nor the layer changes.
+   ResetContent();
+   m_owner_name.SetText(nullptr);
+}
+
 void Section::SetOwnerName(const char* name)
 {
    if (m_owner_name.SetText(name))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    m_sticker.Update();
 }
@@ -319,152 +463,292 @@ void Section::SetTitle(ImageType image, const char* date, const char* time, cons
    auto& title = GetTitle();
    if (title.SetImage(image))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    if (title.SetDate(date))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    if (title.SetTime(time))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    if (title.SetDescription(desc))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    if (title.SetColor(color))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    m_sticker.Update();
 }
 
 void Section::SetHeader(ImageType image, const char* text, const char* clickable_text)
 {
-   auto header = static_cast<SectionHeader*>(Group::GetObject(idxHeader));
-   if (header->SetImage(image))
+   if (!IsMaterialized())
    {
-      m_sticker.SetDirty();
+      m_raw_content->m_header_texts = PackStrings({ text, clickable_text });
+      m_raw_content->m_header_image = image;
+      m_raw_content->m_has_header = true;
    }
-   if (header->SetText(text))
+   else if (ApplyHeader(image, text, clickable_text))
    {
-      m_sticker.SetDirty();
-   }
-   if (header->SetClickableText(clickable_text))
-   {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    m_sticker.Update();
 }
 
 void Section::SetFooter(ImageType image, const char* prefix, const char* desc, ColorType color, bool is_clickable)
 {
-   auto footer = static_cast<SectionFooter*>(Group::GetObject(idxFooter));
-   if (footer->SetImage(image))
+   if (!IsMaterialized())
    {
-      m_sticker.SetDirty();
+      m_raw_content->m_footer_texts = PackStrings({ prefix, desc });
+      m_raw_content->m_footer_image = image;
+      m_raw_content->m_footer_color = color;
+      m_raw_content->m_is_footer_clickable = is_clickable;
+      m_raw_content->m_has_footer = true;
    }
-   if (footer->SetPrefix(prefix))
+   else if (ApplyFooter(image, prefix, desc, color, is_clickable))
    {
-      m_sticker.SetDirty();
+      SetDirty();
+   }
+   m_sticker.Update();
+}
+
+void Section::SetItemCount(unsigned long count)
+{
+   if (!IsMaterialized())
+   {
+      m_raw_content->m_items.resize(count, RawContent::Item{ std::string(), ImageType::None, false, false });
    }
-   if (footer->SetDescription(desc))
+   else if (ApplyItemCount(count))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
-   if (footer->SetColor(color))
+   m_sticker.Update();
+}
+
+void Section::SetItem(unsigned long index, ImageType image, const char* date, const char* time,
+                      const char* desc, bool is_clickable)
+{
+   if (!IsMaterialized())
    {
-      m_sticker.SetDirty();
+      auto& item = m_raw_content->m_items.at(index);
+      item.m_texts = PackStrings({ date, time, desc });
+      item.m_image = image;
+      item.m_is_clickable = is_clickable;
+      item.m_is_set = true;
    }
-   if (footer->SetClickable(is_clickable))
+   else if (ApplyItem(index, image, date, time, desc, is_clickable))
    {
-      m_sticker.SetDirty();
+      SetDirty();
    }
    m_sticker.Update();
 }
 
-void Section::SetItemCount(unsigned long count)
+void Section::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
 {
-   auto items = static_cast<Group*>(Group::GetObject(idxItems));
-   if (items->SetObjectCount(count))
+   if (!IsMaterialized() && !GetTitle().GetDescription().GetCollapsed())
    {
-      m_sticker.SetDirty();
+      Materialize();
+   }
+   if (IsMaterialized() && !GetTitle().GetDescription().GetCollapsed())
+   {
+      ApplyWidth();
+   }
+
+   LayeredGroup::RecalculateBoundary(x, y, graphics);
+   
+   if (!GetTitle().GetDescription().GetCollapsed())
+   {
+      // Place owner name on the level of the first section item (or the items group,
+      // if there are no items), margined to left boundary.
+      auto items = static_cast<Group*>(Group::GetObject(idxItems));
+      auto first_item = (items->GetObjectCount() > 0) ? items->GetObject(0) : nullptr;
+      auto& first_item_boundary = (first_item != nullptr) ? first_item->GetBoundary() : items->GetBoundary();
+      
+      m_owner_name.RecalculateBoundary(first_item_boundary.X, first_item_boundary.Y, graphics);
+      m_owner_name.OffsetBoundary(m_boundary.Width - m_owner_name.GetBoundary().Width - g_indent_horz, 0);
    }
-   m_sticker.Update();
 }
 
-void Section::SetItem(unsigned long index, ImageType image, const char* date, const char* time,
-                      const char* desc, bool is_clickable)
+void Section::CollectMemoryUsage(BGO::MemoryUsage& usage) const
 {
-   auto items = static_cast<Group*>(Group::GetObject(idxItems));
+   LayeredGroup::CollectMemoryUsage(usage);
+   usage.AddNode(typeid(*this), sizeof(Section) - sizeof(LayeredGroup) - sizeof(OwnerName), 0);
+   m_owner_name.CollectMemoryUsage(usage);
 
-   auto item = static_cast<SectionItem*>(items->GetObject(index));
-   if (nullptr == item)
+   if (!IsMaterialized())
    {
-      auto item_ptr = std::make_unique<SectionItem>();
-      item = item_ptr.get();
-      items->SetObject(index, std::move(item_ptr), AligningType::Min, g_indent_vert);
+      usage.AddNode(typeid(RawContent), sizeof(RawContent));
+      usage.AddChildVectors(m_raw_content->m_items.capacity() * sizeof(RawContent::Item));
+      usage.AddStrings(BGO::MemoryUsage::GetStringSize(m_raw_content->m_header_texts) +
+                       BGO::MemoryUsage::GetStringSize(m_raw_content->m_footer_texts));
+      for (const auto& item : m_raw_content->m_items)
+      {
+         usage.AddStrings(BGO::MemoryUsage::GetStringSize(item.m_texts));
+      }
    }
+}
 
-   if (item->SetImage(image))
+bool Section::IsObjectVisible(unsigned long index) const
+{
+   return (IsMaterialized() && !GetTitle().GetDescription().GetCollapsed()) || idxTitle == index;
+}
+
+void Section::DrawLayer(Gdiplus::Graphics* graphics) const
+{
+   LayeredGroup::DrawLayer(graphics);
+   if (!GetTitle().GetDescription().GetCollapsed())
    {
-      m_sticker.SetDirty();
+      m_owner_name.Draw(graphics);
    }
-   if (item->SetDate(date))
+}
+
+void Section::RecordLayer(BGO::DisplayList& list) const
+{
+   LayeredGroup::RecordLayer(list);
+   if (!GetTitle().GetDescription().GetCollapsed())
    {
-      m_sticker.SetDirty();
+      list.Record(m_owner_name);
    }
-   if (item->SetTime(time))
+}
+
+bool Section::IsLayerShown() const
+{
+   // Collapsed sticker draws the title of the first section without the section.
+   return !m_sticker.GetCollapsed();
+}
+
+void Section::SetDirty()
+{
+   LayeredGroup::InvalidateLayer();
+   m_sticker.SetDirty();
+}
+
+bool Section::IsMaterialized() const
+{
+   return !m_raw_content;
+}
+
+void Section::Materialize()
+{
+   std::unique_ptr<RawContent> raw_content;
+   raw_content.swap(m_raw_content);
+
+   Group::SetObject(idxLineBefore, std::make_unique<SectionLine>(), AligningType::Min, g_indent_vert);
+   Group::SetObject(idxHeader, std::make_unique<SectionHeader>(), AligningType::Min, g_indent_vert);
+   Group::SetObject(idxItems, std::make_unique<Group>(GroupType::Vertical), AligningType::Min, g_indent_vert);
+   Group::SetObject(idxFooter, std::make_unique<SectionFooter>(), AligningType::Min, g_indent_vert);
+   Group::SetObject(idxLineAfter, std::make_unique<SectionLine>(), AligningType::Min, g_indent_vert);
+
+   if (raw_content->m_has_header)
    {
-      m_sticker.SetDirty();
+      const auto text = raw_content->m_header_texts.c_str();
+      ApplyHeader(raw_content->m_header_image, text, NextPackedString(text));
    }
-   if (item->SetDescription(desc))
+
+   if (raw_content->m_has_footer)
    {
-      m_sticker.SetDirty();
+      const auto prefix = raw_content->m_footer_texts.c_str();
+      ApplyFooter(raw_content->m_footer_image, prefix, NextPackedString(prefix),
+                  raw_content->m_footer_color, raw_content->m_is_footer_clickable);
    }
-   if (item->SetClickable(is_clickable))
+
+   const auto& items = raw_content->m_items;
+   ApplyItemCount(static_cast<unsigned long>(items.size()));
+   for (auto index = 0UL; index < items.size(); ++index)
    {
-      m_sticker.SetDirty();
+      const auto& item = items[index];
+      if (item.m_is_set)
+      {
+         const auto date = item.m_texts.c_str();
+         const auto time = NextPackedString(date);
+         ApplyItem(index, item.m_image, date, time, NextPackedString(time), item.m_is_clickable);
+      }
    }
 
-   m_sticker.Update();
+   LayeredGroup::InvalidateLayer();
 }
 
-void Section::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
+bool Section::ApplyHeader(ImageType image, const char* text, const char* clickable_text)
 {
-   Group::RecalculateBoundary(x, y, graphics);
-   
-   if (!GetTitle().GetDescription().GetCollapsed())
+   auto header = static_cast<SectionHeader*>(Group::GetObject(idxHeader));
+   auto is_changed = header->SetImage(image);
+   is_changed |= header->SetText(text);
+   is_changed |= header->SetClickableText(clickable_text);
+   return is_changed;
+}
+
+bool Section::ApplyFooter(ImageType image, const char* prefix, const char* desc, ColorType color, bool is_clickable)
+{
+   auto footer = static_cast<SectionFooter*>(Group::GetObject(idxFooter));
+   auto is_changed = footer->SetImage(image);
+   is_changed |= footer->SetPrefix(prefix);
+   is_changed |= footer->SetDescription(desc);
+   is_changed |= footer->SetColor(color);
+   is_changed |= footer->SetClickable(is_clickable);
+   return is_changed;
+}
+
+bool Section::ApplyItemCount(unsigned long count)
+{
+   auto items = static_cast<Group*>(Group::GetObject(idxItems));
+   return items->SetObjectCount(count);
+}
+
+bool Section::ApplyItem(unsigned long index, ImageType image, const char* date, const char* time,
+                        const char* desc, bool is_clickable)
+{
+   auto items = static_cast<Group*>(Group::GetObject(idxItems));
+
+   auto item = static_cast<SectionItem*>(items->GetObject(index));
+   if (nullptr == item)
    {
-      auto items = static_cast<Group*>(Group::GetObject(idxItems));
-      auto first_item = static_cast<SectionItem*>(items->GetObject(0));
-      auto& first_item_boundary = first_item->GetBoundary();
-      
-      // Place owner name on the level of the first section item, margined to left boundary.
-      m_owner_name.RecalculateBoundary(first_item_boundary.X, first_item_boundary.Y, graphics);
-      m_owner_name.OffsetBoundary(m_boundary.Width - m_owner_name.GetBoundary().Width - g_indent_horz, 0);
+      auto item_ptr = std::make_unique<SectionItem>();
+      item = item_ptr.get();
+      items->SetObject(index, std::move(item_ptr), AligningType::Min, g_indent_vert);
    }
+
+   auto is_changed = item->SetImage(image);
+   is_changed |= item->SetDate(date);
+   is_changed |= item->SetTime(time);
+   is_changed |= item->SetDescription(desc);
+   is_changed |= item->SetClickable(is_clickable);
+   return is_changed;
 }
 
-void Section::Draw(Gdiplus::Graphics* graphics) const
+void Section::ResetContent()
 {
-   Group::Draw(graphics);
-   if (!GetTitle().GetDescription().GetCollapsed())
+   // The rest objects are created by Materialize, but indents are needed for layout already.
+   for (auto index : { idxLineBefore, idxHeader, idxItems, idxFooter, idxLineAfter })
    {
-      m_owner_name.Draw(graphics);
+      Group::SetObject(index, nullptr, AligningType::Min, g_indent_vert);
    }
+
+   m_raw_content.reset(new RawContent{ std::string(), ImageType::None, false,
+                                       std::string(), ImageType::None, ColorType::Green, false, false,
+                                       std::vector<RawContent::Item>() });
 }
 
-bool Section::IsObjectVisible(unsigned long index) const
+void Section::ApplyWidth()
 {
-   return !GetTitle().GetDescription().GetCollapsed() || idxTitle == index;
+   // Only the lines and the wrapped header depend on the width, the rest keeps its metrics.
+   auto is_changed = static_cast<SectionLine*>(Group::GetObject(idxLineBefore))->SetWidth(m_width);
+   is_changed |= static_cast<SectionLine*>(Group::GetObject(idxLineAfter))->SetWidth(m_width);
+   is_changed |= static_cast<SectionHeader*>(Group::GetObject(idxHeader))->SetWidth(m_width);
+   if (is_changed)
+   {
+      LayeredGroup::InvalidateLayer();
+   }
 }
 
 ////////// class Sections /////////////
 
-Sections::Sections(Sticker& sticker) : 
-   Group(GroupType::Vertical), m_sticker(sticker), m_is_shorted(true)
+Sections::Sections(StickerModel& sticker) : 
+   Group(GroupType::Vertical), m_sticker(sticker), m_is_shorted(true),
+   m_is_live_resize(false), m_width(g_default_section_width)
 {
 }
 
@@ -498,6 +782,8 @@ Section& Sections::GetSection(unsigned long index)
       auto section_ptr = std::make_unique<Section>(m_sticker);
       section = section_ptr.get();
       section->GetTitle().GetDescription().SetCollapsed(index > 0);
+      section->SetWidth(m_width);
+      section->SetLiveResize(m_is_live_resize);
       Group::SetObject(index, std::move(section_ptr), AligningType::Min, g_indent_vert);
    }
    return *section;
@@ -523,6 +809,30 @@ void Sections::CollapseAllExcludingFirst()
    }
 }
 
+void Sections::SetWidth(unsigned long width)
+{
+   m_width = width;
+   for (auto index = 0UL; index < GetSectionCount(); ++index)
+   {
+      if (Group::GetObject(index) != nullptr)
+      {
+         GetSection(index).SetWidth(width);
+      }
+   }
+}
+
+void Sections::SetLiveResize(bool is_live_resize)
+{
+   m_is_live_resize = is_live_resize;
+   for (auto index = 0UL; index < GetSectionCount(); ++index)
+   {
+      if (Group::GetObject(index) != nullptr)
+      {
+         GetSection(index).SetLiveResize(is_live_resize);
+      }
+   }
+}
+
 // Group overrides
 BGO::Object::ClickType Sections::ProcessClick(long x, long y, BGO::TULongVector& group_indexes)
 {
@@ -557,11 +867,33 @@ BGO::Object::ClickType Sections::ProcessClick(long x, long y, BGO::TULongVector&
    return click;
 }
 
+void Sections::CollectMemoryUsage(BGO::MemoryUsage& usage) const
+{
+   Group::CollectMemoryUsage(usage);
+   usage.AddNode(typeid(*this), sizeof(Sections) - sizeof(Group), 0);
+}
+
 bool Sections::IsObjectVisible(unsigned long index) const
 {
    return !m_is_shorted || (index < g_shorted_section_amount);
 }
 
+bool Sections::IsSectionShown(unsigned long index) const
+{
+   return IsObjectVisible(index);
+}
+
+unsigned long Sections::GetShownSectionCount() const
+{
+   return m_is_shorted ? (std::min)(GetSectionCount(), g_shorted_section_amount) : GetSectionCount();
+}
+
+bool Sections::IsSectionExpanded(unsigned long index) const
+{
+   const auto section = static_cast<const Section*>(Group::GetObject(index));
+   return section != nullptr && !section->GetTitle().GetDescription().GetCollapsed();
+}
+
 ///////////// class More ///////////////
 
 More::More() :
@@ -587,9 +919,11 @@ void More::SetMoreCount(unsigned long count)
 
 ////////// class StickerGraphicObject /////////////
 
-StickerObject::StickerObject(Sticker& sticker) :
+StickerObject::StickerObject(StickerModel& sticker) :
    Group(GroupType::Vertical, g_indent_horz, g_indent_vert),
-   m_collapsed_boundary(), m_is_collapsed(true), m_sticker(sticker)
+   m_collapsed_boundary(), m_is_collapsed(true), m_width(g_default_section_width + g_indent_horz),
+   m_expanded_boundary(), m_expanded_title_origin(), m_is_expanded_layout_prepared(false), m_sticker(sticker),
+   m_transition_starts(), m_transition_objects(), m_transition_start_bottom(0), m_more_offset(0)
 {
    Group::SetObjectCount(idxLast);
    Group::SetObject(idxSections, std::make_unique<Sections>(sticker), AligningType::Min, g_indent_vert);
@@ -604,6 +938,52 @@ void StickerObject::Initialize(const RECT& boundary)
    m_collapsed_boundary.Height = boundary.bottom - boundary.top;
 }
 
+const Gdiplus::RectF& StickerObject::GetCollapsedBoundary() const
+{
+   return m_collapsed_boundary;
+}
+
+bool StickerObject::SetCollapsed(bool is_collapsed)
+{
+   if (m_is_collapsed != is_collapsed)
+   {
+      m_is_collapsed = is_collapsed;
+      return true;
+   }
+   return false;
+}
+
+bool StickerObject::GetCollapsed() const
+{
+   return m_is_collapsed;
+}
+
+void StickerObject::SetWidth(unsigned long width)
+{
+   // Sections are placed after the left indent of the sticker.
+   const auto section_width = (std::max)(g_min_section_width, width - (std::min)(width, g_indent_horz));
+   if (m_width != section_width + g_indent_horz)
+   {
+      m_width = section_width + g_indent_horz;
+      GetSections().SetWidth(section_width);
+      DiscardExpandedLayout();
+      if (!m_is_collapsed)
+      {
+         m_sticker.SetDirty();
+      }
+   }
+}
+
+unsigned long StickerObject::GetWidth() const
+{
+   return m_width;
+}
+
+void StickerObject::SetLiveResize(bool is_live_resize)
+{
+   GetSections().SetLiveResize(is_live_resize);
+}
+
 void StickerObject::SetSectionCount(unsigned long count)
 {
    GetSections().SetSectionCount(count);
@@ -625,12 +1005,156 @@ Section& StickerObject::GetSection(unsigned long index)
    return GetSections().GetSection(index);
 }
 
+unsigned long StickerObject::GetShownSectionCount() const
+{
+   return GetSections().GetShownSectionCount();
+}
+
+bool StickerObject::IsSectionExpanded(unsigned long index) const
+{
+   return GetSections().IsSectionExpanded(index);
+}
+
 BGO::Object::ClickType StickerObject::ProcessClick(long x, long y)
 {
    BGO::TULongVector group_indexes;
    return ProcessClick(x, y, group_indexes);
 }
 
+void StickerObject::PrepareExpandedLayout(Gdiplus::Graphics* graphics, bool is_rendered)
+{
+   if (!m_is_collapsed || m_is_expanded_layout_prepared)
+   {
+      return;
+   }
+
+   Group::RecalculateBoundary(0, 0, graphics);
+   m_expanded_boundary = m_boundary;
+   const auto& title_boundary = GetSection(0).GetTitle().GetBoundary();
+   m_expanded_title_origin = Gdiplus::PointF(title_boundary.X, title_boundary.Y);
+
+   if (is_rendered)
+   {
+      // Drawing is clipped out, it only renders the layers and texts into their caches.
+      graphics->SetClip(Gdiplus::RectF(0, 0, 0, 0));
+      Group::Draw(graphics);
+      graphics->ResetClip();
+   }
+
+   // Back to the collapsed layout, as it is shown now.
+   GetSection(0).GetTitle().RecalculateBoundary(0, 0, graphics);
+   m_boundary = m_collapsed_boundary;
+   m_is_expanded_layout_prepared = true;
+}
+
+bool StickerObject::IsExpandedLayoutPrepared() const
+{
+   return m_is_expanded_layout_prepared;
+}
+
+void StickerObject::DiscardExpandedLayout()
+{
+   m_is_expanded_layout_prepared = false;
+}
+
+void StickerObject::SaveTransitionStart()
+{
+   const auto count = GetSectionCount();
+   m_transition_starts.resize(count + 1);
+   for (auto index = 0UL; index <= count; ++index)
+   {
+      const auto is_shown = IsTransitionObjectShown(index);
+      const auto top = is_shown ? GetTransitionObject(index).GetBoundary().Y + GetTransitionOffset(index) : 0;
+      m_transition_starts[index] = TransitionStart{ is_shown, top };
+   }
+   m_transition_start_bottom = m_boundary.GetBottom();
+}
+
+bool StickerObject::StartTransition()
+{
+   m_transition_objects.clear();
+
+   const auto count = GetSectionCount();
+   if (m_transition_starts.size() != count + 1)
+   {
+      return false;
+   }
+
+   for (auto index = 0UL; index <= count; ++index)
+   {
+      if (!IsTransitionObjectShown(index))
+      {
+         SetTransitionOffset(index, 0);
+         continue;
+      }
+
+      // Objects, which have just appeared, slide out from under the old content.
+      const auto top = GetTransitionObject(index).GetBoundary().Y;
+      const auto& start = m_transition_starts[index];
+      const auto start_top = start.m_is_shown ? start.m_top : (std::min)(top, m_transition_start_bottom);
+
+      const auto offset = std::round(start_top - top);
+      SetTransitionOffset(index, offset);
+      if (offset != 0)
+      {
+         m_transition_objects.push_back(TransitionObject{ index, offset });
+      }
+   }
+   return IsTransitionActive();
+}
+
+bool StickerObject::AdvanceTransition(double progress, std::vector<Gdiplus::RectF>& damaged_rects)
+{
+   progress = (std::min)((std::max)(progress, 0.0), 1.0);
+   // Ease out: objects start fast and slow down to their places.
+   const auto remaining = std::pow(1.0 - progress, 3);
+
+   std::vector<Gdiplus::RectF> strips;
+   for (const auto& object : m_transition_objects)
+   {
+      const auto old_offset = GetTransitionOffset(object.m_index);
+      const auto new_offset = static_cast<Gdiplus::REAL>(std::round(object.m_start_offset * remaining));
+      if (old_offset != new_offset)
+      {
+         SetTransitionOffset(object.m_index, new_offset);
+
+         // Strip covers both places of the object across the whole sticker.
+         const auto& boundary = GetTransitionObject(object.m_index).GetBoundary();
+         const auto top = std::floor(boundary.Y + (std::min)(old_offset, new_offset));
+         const auto bottom = std::ceil(boundary.GetBottom() + (std::max)(old_offset, new_offset));
+         strips.push_back(Gdiplus::RectF(m_boundary.X, top, m_boundary.Width, bottom - top));
+      }
+   }
+
+   std::sort(strips.begin(), strips.end(), [](const Gdiplus::RectF& lhs, const Gdiplus::RectF& rhs)
+   {
+      return lhs.Y < rhs.Y;
+   });
+   for (const auto& strip : strips)
+   {
+      if (!damaged_rects.empty() && damaged_rects.back().GetBottom() >= strip.Y)
+      {
+         auto& last = damaged_rects.back();
+         last.Height = (std::max)(last.GetBottom(), strip.GetBottom()) - last.Y;
+      }
+      else
+      {
+         damaged_rects.push_back(strip);
+      }
+   }
+
+   if (progress >= 1.0)
+   {
+      m_transition_objects.clear();
+   }
+   return IsTransitionActive();
+}
+
+bool StickerObject::IsTransitionActive() const
+{
+   return !m_transition_objects.empty();
+}
+
 void StickerObject::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics)
 {
    if (m_is_collapsed)
@@ -638,9 +1162,17 @@ void StickerObject::RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplu
       GetSection(0).GetTitle().RecalculateBoundary(x, y, graphics);
       m_boundary = m_collapsed_boundary;
    }
+   else if (m_is_expanded_layout_prepared && 0 == x && 0 == y)
+   {
+      // Layout is prepared at the origin, only the first title returns to its expanded place.
+      GetSection(0).GetTitle().RecalculateBoundary(m_expanded_title_origin.X, m_expanded_title_origin.Y, graphics);
+      m_boundary = m_expanded_boundary;
+      m_is_expanded_layout_prepared = false;
+   }
    else
    {
       Group::RecalculateBoundary(x, y, graphics);
+      m_is_expanded_layout_prepared = false;
    }
 }
 
@@ -653,10 +1185,80 @@ void StickerObject::Draw(Gdiplus::Graphics* graphics) const
    {
       GetSection(0).GetTitle().Draw(graphics);
    }
-   else
+   else if (0 == m_more_offset)
    {
       Group::Draw(graphics);
    }
+   else
+   {
+      // Sections slide by themselves, "More" is moved here.
+      GetSections().Draw(graphics);
+      graphics->TranslateTransform(0, m_more_offset);
+      GetMore().Draw(graphics);
+      graphics->TranslateTransform(0, -m_more_offset);
+   }
+}
+
+void StickerObject::Draw(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const
+{
+   if (m_is_collapsed)
+   {
+      Draw(graphics);
+      return;
+   }
+
+   Gdiplus::SolidBrush back_brush(Colors::grey_very_light);
+   graphics->FillRectangle(&back_brush, GetBoundary());
+
+   const auto section_count = GetSectionCount();
+   for (auto index = 0UL; index <= section_count; ++index)
+   {
+      if (!IsTransitionObjectShown(index))
+      {
+         continue;
+      }
+
+      auto boundary = GetTransitionObject(index).GetBoundary();
+      boundary.Y += GetTransitionOffset(index);
+      if (boundary.IntersectsWith(rect) == FALSE)
+      {
+         continue;
+      }
+
+      if (index < section_count)
+      {
+         // Section slides by itself.
+         GetSection(index).Draw(graphics);
+      }
+      else
+      {
+         graphics->TranslateTransform(0, m_more_offset);
+         GetMore().Draw(graphics);
+         graphics->TranslateTransform(0, -m_more_offset);
+      }
+   }
+}
+
+void StickerObject::Record(BGO::DisplayList& list) const
+{
+   // The same as Draw
+   list.AddFill(GetBoundary(), Colors::grey_very_light.GetValue());
+
+   if (m_is_collapsed)
+   {
+      list.Record(GetSection(0).GetTitle());
+   }
+   else if (0 == m_more_offset)
+   {
+      Group::Record(list);
+   }
+   else
+   {
+      list.Record(GetSections());
+      list.AddOffset(m_more_offset);
+      list.Record(GetMore());
+      list.AddOffset(-m_more_offset);
+   }
 }
 
 BGO::Object::ClickType StickerObject::ProcessClick(long x, long y, BGO::TULongVector& group_indexes)
@@ -700,6 +1302,12 @@ BGO::Object::ClickType StickerObject::ProcessClick(long x, long y, BGO::TULongVe
    return click;
 }
 
+void StickerObject::CollectMemoryUsage(BGO::MemoryUsage& usage) const
+{
+   Group::CollectMemoryUsage(usage);
+   usage.AddNode(typeid(*this), sizeof(StickerObject) - sizeof(Group), 0);
+}
+
 bool StickerObject::IsObjectVisible(unsigned long index) const
 {
    return GetSections().GetShorted() || (idxSections == index);
@@ -715,10 +1323,56 @@ Sections& StickerObject::GetSections()
    return *static_cast<Sections*>(Group::GetObject(idxSections));
 }
 
+const More& StickerObject::GetMore() const
+{
+   return *static_cast<const More*>(Group::GetObject(idxMore));
+}
+
 More& StickerObject::GetMore()
 {
    return *static_cast<More*>(Group::GetObject(idxMore));
 }
 
+bool StickerObject::IsTransitionObjectShown(unsigned long index) const
+{
+   if (m_is_collapsed)
+   {
+      return false;
+   }
+   const auto& sections = GetSections();
+   return (index < sections.GetSectionCount()) ? sections.IsSectionShown(index) : sections.GetShorted();
+}
+
+const BGO::Object& StickerObject::GetTransitionObject(unsigned long index) const
+{
+   if (index < GetSectionCount())
+   {
+      return GetSection(index);
+   }
+   return GetMore();
+}
+
+Gdiplus::REAL StickerObject::GetTransitionOffset(unsigned long index) const
+{
+   return (index < GetSectionCount()) ? GetSection(index).GetDrawOffset() : m_more_offset;
+}
+
+void StickerObject::SetTransitionOffset(unsigned long index, Gdiplus::REAL offset)
+{
+   if (index < GetSectionCount())
+   {
+      // Sections, which were never shown, may be not created yet.
+      auto section = static_cast<Section*>(GetSections().GetObject(index));
+      if (section != nullptr)
+      {
+         section->SetDrawOffset(offset);
+      }
+   }
+   else
+   {
+      m_more_offset = offset;
+   }
+}
+
 
 } // namespace SGO
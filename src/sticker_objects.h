@@ -7,6 +7,19 @@
 namespace SGO
 {
 
+// Indents are part of compile-time layout of fixed groups, so they are defined here.
+const auto g_indent_vert = 3UL;
+const auto g_indent_horz = 3UL;
+
+using Aligning = BGO::Group::AligningType;
+
+class ItemImage : public BGO::Image
+{
+public:
+   ItemImage();
+   bool SetImage(ImageType image);
+};
+
 class ItemDate : public BGO::Text
 {
 public:
@@ -25,11 +38,13 @@ public:
    ItemDescription();
 };
 
-class SectionItem : public BGO::Group
+class SectionItem : public BGO::FixedGroup<SectionItem, BGO::Group::GroupType::Horizontal,
+                                           BGO::FixedChild<ItemImage, Aligning::Max, g_indent_horz>,
+                                           BGO::FixedChild<ItemDate, Aligning::Max, g_indent_horz>,
+                                           BGO::FixedChild<ItemTime, Aligning::Max, g_indent_horz>,
+                                           BGO::FixedChild<ItemDescription, Aligning::Max, g_indent_horz>>
 {
 public:
-   SectionItem();
-
    bool SetImage(ImageType image);
    bool SetDate(const char* text);
    bool SetTime(const char* text);
@@ -38,9 +53,10 @@ public:
 
 private:
    enum Indexes { idxImage, idxDate, idxTime, idxDesc, idxLast };
+   static_assert(idxLast == ObjectCount, "Indexes don't match children");
 };
 
-class HeaderDescriptionText : public BGO::Text
+class HeaderDescriptionText : public BGO::WrappedText
 {
 public:
    HeaderDescriptionText();
@@ -52,29 +68,34 @@ public:
    HeaderDescriptionClickabeText();
 };
 
-class HeaderDescription : public BGO::Group
+class HeaderDescription : public BGO::FixedGroup<HeaderDescription, BGO::Group::GroupType::Vertical,
+                                                 BGO::FixedChild<HeaderDescriptionText, Aligning::Max, g_indent_vert>,
+                                                 BGO::FixedChild<HeaderDescriptionClickabeText, Aligning::Max, 0>>
 {
 public:
-   HeaderDescription();
-   
    bool SetText(const char* text);
    bool SetClickableText(const char* text);
+   bool SetWidth(unsigned long width);
    
 private:
-   enum Indexes { idxText, idxClkText, idxLast };   
+   enum Indexes { idxText, idxClkText, idxLast };
+   static_assert(idxLast == ObjectCount, "Indexes don't match children");
 };
 
-class SectionHeader : public BGO::Group
+class SectionHeader : public BGO::FixedGroup<SectionHeader, BGO::Group::GroupType::Horizontal,
+                                             BGO::FixedChild<ItemImage, Aligning::Max, g_indent_horz>,
+                                             BGO::FixedChild<HeaderDescription, Aligning::Max, g_indent_horz>>
 {
 public:
-   SectionHeader();
-
    bool SetImage(ImageType image);
    bool SetText(const char* text);
    bool SetClickableText(const char* text);
+   // Width of the whole section, the description is wrapped at the rest of it.
+   bool SetWidth(unsigned long section_width);
 
 private:
    enum Indexes { idxImage, idxDesc, idxLast };
+   static_assert(idxLast == ObjectCount, "Indexes don't match children");
 };
 
 class FooterPrefix : public BGO::Text
@@ -89,11 +110,12 @@ public:
    FooterDescription();
 };
 
-class SectionFooter : public BGO::Group
+class SectionFooter : public BGO::FixedGroup<SectionFooter, BGO::Group::GroupType::Horizontal,
+                                             BGO::FixedChild<ItemImage, Aligning::Max, g_indent_horz>,
+                                             BGO::FixedChild<FooterPrefix, Aligning::Max, g_indent_horz>,
+                                             BGO::FixedChild<FooterDescription, Aligning::Max, g_indent_horz>>
 {
 public:
-   SectionFooter();
-
    bool SetImage(ImageType image);
    bool SetPrefix(const char* text);
    bool SetDescription(const char* text);
@@ -102,6 +124,7 @@ public:
 
 private:
    enum Indexes { idxImage, idxPrefix, idxDesc, idxLast };
+   static_assert(idxLast == ObjectCount, "Indexes don't match children");
 };
 
 class TitleDescription : public BGO::CollapsibleText
@@ -110,11 +133,16 @@ public:
    TitleDescription();
 };
 
-class SectionTitle : public BGO::Group
+class SectionTitle : public BGO::FixedGroup<SectionTitle, BGO::Group::GroupType::Horizontal,
+                                            BGO::FixedChild<ItemImage, Aligning::Max, g_indent_horz>,
+                                            BGO::FixedChild<ItemDate, Aligning::Max, g_indent_horz>,
+                                            BGO::FixedChild<ItemTime, Aligning::Max, g_indent_horz>,
+                                            BGO::FixedChild<TitleDescription, Aligning::Max, g_indent_horz>>
 {
-public:
-   SectionTitle();
+   // In order to access IsObjectVisible
+   friend Base;
 
+public:
    bool SetImage(ImageType image);
    bool SetDate(const char* text);
    bool SetTime(const char* text);
@@ -125,11 +153,12 @@ public:
    TitleDescription& GetDescription();
 
 protected:
-   // Group override
-   bool IsObjectVisible(unsigned long index) const override;
+   // FixedGroup hiding
+   bool IsObjectVisible(unsigned long index) const;
 
 private:
    enum Indexes { idxImage, idxDate, idxTime, idxDesc, idxLast };
+   static_assert(idxLast == ObjectCount, "Indexes don't match children");
 };
 
 class SectionLine : public BGO::Line
@@ -146,16 +175,26 @@ public:
 
 class Sections;
 
-class Section : public ISection, public BGO::Group
+class Section : public ISection, public BGO::LayeredGroup
 {
    // In order to access Indexes
    friend class Sections;
 
 public:
-   Section(Sticker& sticker);
+   Section(StickerModel& sticker);
+   ~Section();
 
    const SectionTitle& GetTitle() const;
    SectionTitle& GetTitle();
+
+   // Width is applied to the objects on the next layout of the expanded section,
+   // so collapsed sections don't re-wrap their texts until they are shown.
+   void SetWidth(unsigned long width);
+   void SetLiveResize(bool is_live_resize);
+
+   // Returns collapsed section to the state before its content was set, e.g. to keep
+   // only recently used content of a data source. Title stays as it is.
+   void ReleaseContent();
    
    // ISection overrides
    virtual void SetOwnerName(const char* name) override;
@@ -167,23 +206,46 @@ public:
    virtual void SetItem(unsigned long index, ImageType image, const char* date, const char* time,
                         const char* desc, bool is_clickable) override;
    
-   // Group overrides   
+   // LayeredGroup overrides   
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
-   virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const override;
    
 protected:
    virtual bool IsObjectVisible(unsigned long index) const override;
+   virtual void DrawLayer(Gdiplus::Graphics* graphics) const override;
+   virtual void RecordLayer(BGO::DisplayList& list) const override;
+   virtual bool IsLayerShown() const override;
+
+private:
+   void SetDirty();
+
+   // Objects of the header, items and footer are built on the first expanding.
+   // Till then content of the section is kept as raw data.
+   bool IsMaterialized() const;
+   void Materialize();
+   void ResetContent();
+
+   bool ApplyHeader(ImageType image, const char* text, const char* clickable_text);
+   bool ApplyFooter(ImageType image, const char* prefix, const char* desc, ColorType color, bool is_clickable);
+   bool ApplyItemCount(unsigned long count);
+   bool ApplyItem(unsigned long index, ImageType image, const char* date, const char* time,
+                  const char* desc, bool is_clickable);
+   void ApplyWidth();
 
 private:
    enum Indexes { idxLineBefore, idxTitle, idxHeader, idxItems, idxFooter, idxLineAfter, idxLast };
-   Sticker& m_sticker;
+   struct RawContent;
+
+   StickerModel& m_sticker;
    OwnerName m_owner_name;
+   std::unique_ptr<RawContent> m_raw_content;
+   unsigned long m_width;
 };
 
 class Sections : public BGO::Group
 {
 public:
-   Sections(Sticker& sticker);
+   Sections(StickerModel& sticker);
    
    void SetSectionCount(unsigned long count);
    unsigned long GetSectionCount() const;
@@ -193,16 +255,28 @@ public:
    void SetShorted(bool is_shorted);
    bool GetShorted() const;
    void CollapseAllExcludingFirst();
+   bool IsSectionShown(unsigned long index) const;
+   // Shown sections are the first ones.
+   unsigned long GetShownSectionCount() const;
+   // Doesn't create the section.
+   bool IsSectionExpanded(unsigned long index) const;
+
+   // Applied to all sections, including the ones created later.
+   void SetWidth(unsigned long width);
+   void SetLiveResize(bool is_live_resize);
 
    // Group overrides
    virtual ClickType ProcessClick(long x, long y, BGO::TULongVector& group_indexes) override;
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const override;
    
 protected:
    virtual bool IsObjectVisible(unsigned long index) const override;
    
 private:
-   Sticker& m_sticker;
+   StickerModel& m_sticker;
    bool m_is_shorted;
+   bool m_is_live_resize;
+   unsigned long m_width;
 };
 
 class More : public BGO::ClickableText
@@ -215,35 +289,102 @@ public:
 class StickerObject : public BGO::Group
 {
 public:
-   StickerObject(Sticker& sticker);
+   StickerObject(StickerModel& sticker);
 
    void Initialize(const RECT& boundary);
+   const Gdiplus::RectF& GetCollapsedBoundary() const;
+
+   // Returns true, if the state has changed. Content stays the same, so it doesn't discard
+   // the prepared expanded layout, the caller marks the sticker dirty.
+   bool SetCollapsed(bool is_collapsed);
+   bool GetCollapsed() const;
+
+   // Layout of the expanded sticker, computed in advance while it is collapsed, e.g. in idle
+   // time. Expanding then only swaps it in. Rendering fills the caches of section layers and
+   // texts as well. Any change of the content discards it.
+   void PrepareExpandedLayout(Gdiplus::Graphics* graphics, bool is_rendered);
+   bool IsExpandedLayoutPrepared() const;
+   void DiscardExpandedLayout();
+
+   // Width of the expanded sticker, the collapsed one keeps its initial size.
+   void SetWidth(unsigned long width);
+   unsigned long GetWidth() const;
+   void SetLiveResize(bool is_live_resize);
 
    void SetSectionCount(unsigned long count);
    unsigned long GetSectionCount() const;
    const Section& GetSection(unsigned long index) const;
    Section& GetSection(unsigned long index);
+   unsigned long GetShownSectionCount() const;
+   bool IsSectionExpanded(unsigned long index) const;
    
    ClickType ProcessClick(long x, long y);
 
+   // Transition animates a layout change of the expanded sticker: sections and "More" slide
+   // from their old places to the new ones. Start is saved before a click, the transition
+   // is started after the relayout and then advanced by the frame scheduler of the sticker.
+   void SaveTransitionStart();
+   bool StartTransition();
+   // Progress is in [0, 1]. Adds the strips to redraw, sorted and merged.
+   // Returns false, when the transition is finished.
+   bool AdvanceTransition(double progress, std::vector<Gdiplus::RectF>& damaged_rects);
+   bool IsTransitionActive() const;
+   // Draws the part inside the rect (e.g. a damaged strip), which the graphics is clipped to.
+   // Sections and "More", which don't cross it at their current offsets, are skipped.
+   void Draw(Gdiplus::Graphics* graphics, const Gdiplus::RectF& rect) const;
+
    // Group overrides
    virtual void RecalculateBoundary(Gdiplus::REAL x, Gdiplus::REAL y, Gdiplus::Graphics* graphics) override;
    virtual void Draw(Gdiplus::Graphics* graphics) const override;
+   virtual void Record(BGO::DisplayList& list) const override;
    virtual ClickType ProcessClick(long x, long y, BGO::TULongVector& group_indexes) override;
+   virtual void CollectMemoryUsage(BGO::MemoryUsage& usage) const override;
    
 protected:
    virtual bool IsObjectVisible(unsigned long index) const override;
    
    const Sections& GetSections() const;
    Sections& GetSections();
+   const More& GetMore() const;
    More& GetMore();
 
+private:
+   // Objects of the transition are sections by index, the index after the last one is "More".
+   bool IsTransitionObjectShown(unsigned long index) const;
+   const BGO::Object& GetTransitionObject(unsigned long index) const;
+   Gdiplus::REAL GetTransitionOffset(unsigned long index) const;
+   void SetTransitionOffset(unsigned long index, Gdiplus::REAL offset);
+
 private:
    enum Indexes { idxSections, idxMore, idxLast };
 
+   struct TransitionStart
+   {
+      bool m_is_shown;
+      Gdiplus::REAL m_top;
+   };
+
+   struct TransitionObject
+   {
+      unsigned long m_index;
+      Gdiplus::REAL m_start_offset;
+   };
+
    Gdiplus::RectF m_collapsed_boundary;
    bool m_is_collapsed;
-   Sticker& m_sticker;
+   unsigned long m_width;
+
+   // First section title is placed differently in collapsed sticker, so its expanded place is kept.
+   Gdiplus::RectF m_expanded_boundary;
+   Gdiplus::PointF m_expanded_title_origin;
+   bool m_is_expanded_layout_prepared;
+
+   StickerModel& m_sticker;
+
+   std::vector<TransitionStart> m_transition_starts;
+   std::vector<TransitionObject> m_transition_objects;
+   Gdiplus::REAL m_transition_start_bottom;
+   Gdiplus::REAL m_more_offset;
 };
 
 } // namespace SGO